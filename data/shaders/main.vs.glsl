@@ -1,21 +1,32 @@
 #version 460 core
 
-layout (location = 0) in vec3 iPosition;
+// The same locations are used by both vertex formats, with the compact format:
+// - iPosition is unorm16 relative to the mesh bounds, w holds the tangent sign
+// - iNormal.xy and iTangent.xy are octahedral encoded
+layout (location = 0) in vec4 iPosition;
 layout (location = 1) in vec3 iNormal;
 layout (location = 2) in vec2 iUv;
 layout (location = 3) in vec4 iTangent;
 
 layout (location = 0) out vec2 oUvs;
 layout (location = 1) out flat uint oBaseColorIndex;
+layout (location = 2) out vec3 oNormal;
+layout (location = 3) out vec4 oTangent;
 
 layout (location = 0) uniform mat4 uProjection;
 layout (location = 1) uniform mat4 uView;
 
+const uint VERTEX_FORMAT_STANDARD = 0;
+const uint VERTEX_FORMAT_COMPACT = 1;
+
 struct ObjectData
 {
     uint transformIndex;
     uint baseColorIndex;
     uint normalIndex;
+    uint vertexFormat;
+    vec4 positionOffset;
+    vec4 positionScale;
 };
 
 layout (binding = 0) buffer BObjectData
@@ -28,9 +39,33 @@ layout (binding = 1) buffer BTransforms
     mat4[] transforms;
 };
 
+vec3 OctahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
 void main()
 {
+    // The scene stores the index of each draw's object data in its base instance
+    ObjectData object = objectData[gl_BaseInstance];
+    mat4 transform = transforms[object.transformIndex];
+    // Standard vertices use an offset of 0 and a scale of 1
+    vec3 position = object.positionOffset.xyz + iPosition.xyz * object.positionScale.xyz;
+    vec3 normal = iNormal;
+    vec4 tangent = iTangent;
+    if (object.vertexFormat == VERTEX_FORMAT_COMPACT)
+    {
+        normal = OctahedralDecode(iNormal.xy);
+        tangent = vec4(OctahedralDecode(iTangent.xy), iPosition.w * 2.0 - 1.0);
+    }
+
     oUvs = iUv;
-    oBaseColorIndex = objectData[gl_DrawID].baseColorIndex;
-    gl_Position = uProjection * uView * transforms[objectData[gl_DrawID].transformIndex] * vec4(iPosition, 1.0);
+    oBaseColorIndex = object.baseColorIndex;
+    oNormal = mat3(transform) * normal;
+    oTangent = vec4(mat3(transform) * tangent.xyz, tangent.w);
+    gl_Position = uProjection * uView * transform * vec4(position, 1.0);
 }
\ No newline at end of file
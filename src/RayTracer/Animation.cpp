@@ -0,0 +1,117 @@
+#include <RayTracer/Animation.h>
+
+#include <RayTracerLib/Parallel.hpp>
+
+#include <tracy/Tracy.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+// Channels sampled by a thread at once, a channel alone is too little work to hand out
+static constexpr size_t CHANNELS_PER_TASK = 256;
+
+static glm::quat ToQuat(const float *value)
+{
+	// glm takes w first, glTF stores it last
+	return glm::quat(value[3], value[0], value[1], value[2]);
+}
+
+static void SampleChannel(const AnimationChannel &channel, float time,
+			  TransformHierarchy &hierarchy)
+{
+	const auto &times = channel.times;
+	if (times.empty()) {
+		return;
+	}
+	const bool rotation = channel.path == AnimationPath::Rotation;
+	const bool cubic =
+		channel.interpolation == AnimationInterpolation::CubicSpline;
+	const size_t width = rotation ? 4 : 3;
+	const size_t stride = cubic ? 3 * width : width;
+	// Cubic spline keys have the value between their tangents
+	const auto value = [&](size_t key) {
+		return &channel.values[key * stride + (cubic ? width : 0)];
+	};
+
+	float result[4];
+	const auto next = (size_t)(std::upper_bound(times.begin(), times.end(),
+						    time) -
+				   times.begin());
+	if (next == 0 || next == times.size() ||
+	    channel.interpolation == AnimationInterpolation::Step) {
+		// Before the first key or after the last one the value holds
+		const auto *held = value(next == 0 ? 0 : next - 1);
+		std::copy(held, held + width, result);
+	} else {
+		const auto key = next - 1;
+		const auto duration = times[next] - times[key];
+		const auto t = (time - times[key]) / duration;
+		if (cubic) {
+			// Hermite spline, tangents are scaled by the time between the keys
+			const auto *outTangent = &channel.values[key * stride + 2 * width];
+			const auto *inTangent = &channel.values[next * stride];
+			const auto t2 = t * t;
+			const auto t3 = t2 * t;
+			const auto h00 = 2.0f * t3 - 3.0f * t2 + 1.0f;
+			const auto h10 = t3 - 2.0f * t2 + t;
+			const auto h01 = -2.0f * t3 + 3.0f * t2;
+			const auto h11 = t3 - t2;
+			for (size_t i = 0; i < width; ++i) {
+				result[i] = h00 * value(key)[i] +
+					    h10 * duration * outTangent[i] +
+					    h01 * value(next)[i] +
+					    h11 * duration * inTangent[i];
+			}
+		} else if (rotation) {
+			// Takes the shortest path between the two rotations
+			const auto q = glm::slerp(ToQuat(value(key)),
+						  ToQuat(value(next)), t);
+			result[0] = q.x;
+			result[1] = q.y;
+			result[2] = q.z;
+			result[3] = q.w;
+		} else {
+			for (size_t i = 0; i < width; ++i) {
+				result[i] = value(key)[i] +
+					    (value(next)[i] - value(key)[i]) * t;
+			}
+		}
+	}
+
+	switch (channel.path) {
+	case AnimationPath::Translation:
+		hierarchy.SetTranslation(
+			channel.node, glm::vec3(result[0], result[1], result[2]));
+		break;
+	case AnimationPath::Rotation:
+		// Cubic splines don't keep the quaternion unit length
+		hierarchy.SetRotation(channel.node,
+				      glm::normalize(ToQuat(result)));
+		break;
+	case AnimationPath::Scale:
+		hierarchy.SetScale(channel.node,
+				   glm::vec3(result[0], result[1], result[2]));
+		break;
+	}
+}
+
+void SampleAnimation(const Animation &animation, double seconds,
+		     TransformHierarchy &hierarchy)
+{
+	ZoneScoped;
+	const auto time =
+		animation.duration > 0.0f ?
+			(float)std::fmod(seconds, (double)animation.duration) :
+			0.0f;
+	const auto &channels = animation.channels;
+	const auto taskCount =
+		(channels.size() + CHANNELS_PER_TASK - 1) / CHANNELS_PER_TASK;
+	ParallelFor(taskCount, [&](size_t task) {
+		const auto first = task * CHANNELS_PER_TASK;
+		const auto last =
+			std::min(first + CHANNELS_PER_TASK, channels.size());
+		for (auto i = first; i < last; ++i) {
+			SampleChannel(channels[i], time, hierarchy);
+		}
+	});
+}
\ No newline at end of file
@@ -13,6 +13,7 @@
 #include <glm/mat4x4.hpp>
 
 #include <spdlog/spdlog.h>
+#include <tracy/Tracy.hpp>
 
 #include <unordered_map>
 #include <filesystem>
@@ -23,6 +24,19 @@
 #include <queue>
 #include <set>
 
+static constexpr const char *VERTEX_SHADER = "data/shaders/main.vs.glsl";
+static constexpr const char *FRAGMENT_SHADER = "data/shaders/main.fs.glsl";
+// Number of hot reloads listed in the UI
+static constexpr size_t RELOAD_HISTORY = 8;
+
+App::App(std::vector<std::string> modelPaths, const BaseAppOptions &options)
+	: BaseApp(options)
+	, _modelPaths(std::move(modelPaths))
+{
+	// Benchmarks must see the same texture levels every run, however long the loads take
+	_sceneInfo.streaming.synchronous = !options.benchmarkOutput.empty();
+}
+
 void App::AfterCreatedUiContext()
 {
 }
@@ -33,43 +47,336 @@ void App::BeforeDestroyUiContext()
 
 bool App::Load()
 {
+	ZoneScoped;
 	if (!BaseApp::Load()) {
 		spdlog::error("App: Unable to load");
 		return false;
 	}
 
+	// Compiles in the background while the scene loads, the first draw waits for it
+	_shader = std::make_unique<Shader>(VERTEX_SHADER, FRAGMENT_SHADER);
+	LoadScene();
+
+	// Plots default to plain numbers
+	TracyPlotConfig("Uploaded bytes", tracy::PlotFormatType::Memory, false,
+			true, 0);
+
+	// Watch our data and the models given on the command line, they may live elsewhere
+	std::vector<std::filesystem::path> directories = { "data" };
+	for (const auto &path : _modelPaths) {
+		// A bare file name lives in the working directory
+		const auto directory = std::filesystem::path(path).parent_path();
+		directories.emplace_back(directory.empty() ? "." : directory);
+	}
+	for (const auto &directory : directories) {
+		if (!_watcher.Watch(directory)) {
+			spdlog::warn("App: Unable to watch {}, its files won't be reloaded",
+				     directory.string());
+		}
+	}
+
 	return true;
 }
 
+void App::Unload()
+{
+	// GPU resources must be released while the context is still alive
+	_scene.reset();
+	_pendingShader.reset();
+	_shader.reset();
+
+	BaseApp::Unload();
+}
+
+void App::LoadScene()
+{
+	ZoneScoped;
+	// The prepared frame points into the scene
+	DiscardPreparedFrame();
+	// Release the previous scene first, so both never hold GPU memory at the same time
+	_scene.reset();
+	_scene = std::make_unique<Scene>(_sceneInfo);
+	for (const auto &path : _modelPaths) {
+		_scene->Load(path, _modelOptions);
+	}
+}
+
 void App::Update(float deltaTime)
 {
+	ZoneScoped;
 	if (IsKeyPressed(GLFW_KEY_ESCAPE)) {
 		Close();
 	}
 
 	_elapsedTime += deltaTime;
+	ReloadChanges();
+}
+
+void App::BuildFrameGraph(TaskGraph &graph)
+{
+	const auto animate = graph.Add("Animate", [this] {
+		// Paused animations keep their time, so their nodes aren't updated again. The offset
+		// follows the frame time meanwhile, they resume where they stopped.
+		const auto time = PreparingFrame().time;
+		if (_animate) {
+			_animationTime = time - _animationOffset;
+		} else {
+			_animationOffset = time - _animationTime;
+		}
+		_scene->Animate(_animationTime);
+	});
+	graph.Add(
+		"Draw list",
+		[this] {
+			const auto &info = PreparingFrame();
+			auto &frame = _frames[info.index % 2];
+			// A minimized window has no pixels
+			const auto width = (float)std::max(GetWidth(), 1);
+			const auto height = (float)std::max(GetHeight(), 1);
+			frame.projection = glm::perspective(glm::radians(80.0f),
+							    width / height, 0.1f,
+							    256.0f);
+			// With a fixed time step the orbit only depends on the frame index, benchmarks see the same frames
+			const auto time = info.time;
+			frame.view = glm::lookAt(
+				glm::vec3(3 * std::cos(time / 4), 2,
+					  -3 * std::sin(time / 4)),
+				glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+			_scene->Prepare(
+				ModelDrawView{
+					frame.projection,
+					frame.view,
+					height,
+					_lodEnabled ? _lodErrorThreshold : 0.0f,
+				},
+				frame.scene);
+		},
+		{ animate });
+}
+
+void App::RecordReload(std::string name,
+		       std::chrono::steady_clock::time_point changeTime)
+{
+	const auto milliseconds =
+		std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - changeTime)
+			.count();
+	spdlog::info("App: Reloaded {} in {:.2f} ms", name, milliseconds);
+	if (_reloads.size() == RELOAD_HISTORY) {
+		_reloads.erase(_reloads.begin());
+	}
+	_reloads.emplace_back(ReloadEvent{ std::move(name), milliseconds });
+}
+
+void App::ReloadChanges()
+{
+	ZoneScoped;
+	const auto changes = _watcher.Poll();
+	for (const auto &change : changes) {
+		// Only the shader that uses the file is compiled again, the current one stays until it's done
+		if (_shader->DependsOn(change.path)) {
+			_pendingShader = std::make_unique<Shader>(VERTEX_SHADER,
+								  FRAGMENT_SHADER);
+			_shaderChangeTime = change.time;
+		}
+	}
+	for (const auto &model : _scene->Models()) {
+		const auto change = std::find_if(
+			changes.begin(), changes.end(),
+			[&](const FileChange &change) {
+				return model->DependsOn(change.path);
+			});
+		// Several files of a model can change at once (a model and its buffers), it's reloaded once
+		if (change != changes.end() && model->Reload()) {
+			// The prepared frame's matrices were never uploaded
+			DiscardPreparedFrame();
+			_scene->InvalidateTransforms();
+			const auto &reload = model->LastReload();
+			RecordReload(fmt::format("{} ({}/{} meshes, {}/{} textures)",
+						 model->Path(),
+						 reload.meshesUploaded,
+						 reload.meshesUploaded +
+							 reload.meshesReused,
+						 reload.texturesLoaded,
+						 reload.texturesLoaded +
+							 reload.texturesReused),
+				     change->time);
+		}
+	}
+
+	if (_pendingShader && _pendingShader->IsReady()) {
+		// A shader with errors is dropped, we keep drawing with the last one that worked
+		if (_pendingShader->IsLinked()) {
+			_shader = std::move(_pendingShader);
+			RecordReload(fmt::format("{} + {}", VERTEX_SHADER,
+						 FRAGMENT_SHADER),
+				     _shaderChangeTime);
+		}
+		_pendingShader.reset();
+	}
 }
 
 void App::RenderScene([[maybe_unused]] float deltaTime)
 {
-	const auto projection = glm::perspective(
-		glm::radians(80.0f), 1920.0f / 1080.0f, 0.1f, 256.0f);
-	const auto view =
-		glm::lookAt(glm::vec3(3 * std::cos(glfwGetTime() / 4), 2,
-				      -3 * std::sin(glfwGetTime() / 4)),
-			    glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+	ZoneScoped;
+	// Prepared by the frame graph, during the last frame or right before this one
+	const auto &frame = _frames[GetFrameIndex() % 2];
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glUniformMatrix4fv(0, 1, false, glm::value_ptr(projection));
-	glUniformMatrix4fv(1, 1, false, glm::value_ptr(view));
+	_shader->Bind();
+	_shader->Set(0, frame.projection);
+	_shader->Set(1, frame.view);
+	_drawStats = _scene->Submit(*_shader, frame.scene);
+	TracyPlot("Draw calls", (int64_t)_drawStats.drawCalls);
+	TracyPlot("Triangles", (int64_t)_drawStats.triangles);
+	TracyPlot("Uploaded bytes", (int64_t)_drawStats.uploadedBytes);
 }
 
 void App::RenderUI(float deltaTime)
 {
+	ZoneScoped;
 	ImGui::Begin("Window");
 	{
 		ImGui::TextUnformatted("Hello World!");
 		ImGui::Text("Time in seconds since startup: %f", _elapsedTime);
 		ImGui::Text("The delta time between frames: %f", deltaTime);
+		ImGui::Separator();
+		bool compact = _sceneInfo.vertexFormat == VertexFormat::Compact;
+		// Changing the layout requires rebuilding the GPU buffers
+		if (ImGui::Checkbox("Compact vertex format", &compact)) {
+			_sceneInfo.vertexFormat = compact ? VertexFormat::Compact :
+							    VertexFormat::Standard;
+			LoadScene();
+		}
+		if (ImGui::Checkbox("16-bit indices", &_sceneInfo.shortIndices)) {
+			LoadScene();
+		}
+		if (ImGui::Checkbox("Optimize meshes",
+				    &_modelOptions.optimization.optimize)) {
+			LoadScene();
+		}
+		// Cached textures are keyed on the format, switching back and forth only encodes once
+		static const char *textureFormats[] = { "RGBA8", "BC1", "BC5",
+							"BC7" };
+		int32_t textureFormat = (int32_t)_modelOptions.textureFormat;
+		if (ImGui::Combo("Texture format", &textureFormat,
+				 textureFormats,
+				 IM_ARRAYSIZE(textureFormats))) {
+			_modelOptions.textureFormat = (TextureFormat)textureFormat;
+			LoadScene();
+		}
+		if (ImGui::Button("Reload scene")) {
+			LoadScene();
+		}
+
+		// Models are unloaded after the loop, so we don't modify the list we are iterating
+		const Model *unload = nullptr;
+		for (const auto &model : _scene->Models()) {
+			const auto &stats = model->Stats();
+			ImGui::PushID(model.get());
+			if (ImGui::TreeNode(model->Path().c_str())) {
+				ImGui::Text("Vertex memory: %.2f MiB",
+					    stats.vertexBytes / (1024.0 * 1024.0));
+				ImGui::Text("Index memory: %.2f MiB",
+					    stats.indexBytes / (1024.0 * 1024.0));
+				ImGui::Text("Texture memory: %.2f MiB (%.2f MiB uncompressed)",
+					    stats.textureBytes /
+						    (1024.0 * 1024.0),
+					    stats.uncompressedTextureBytes /
+						    (1024.0 * 1024.0));
+				ImGui::Text("Texture load time: %.2f ms, %zu cache hits",
+					    stats.textureLoadMilliseconds,
+					    stats.textureCacheHits);
+				if (stats.encodeMilliseconds > 0.0) {
+					ImGui::Text("Encoded %.2f Mpixels at %.2f Mpixels/s",
+						    stats.encodedTexels / 1e6,
+						    stats.encodedTexels /
+							    (stats.encodeMilliseconds *
+							     1e3));
+				}
+				ImGui::Text("Load time: %.2f ms",
+					    stats.loadMilliseconds);
+				ImGui::Text("ACMR: %.3f -> %.3f",
+					    stats.cache.AcmrBefore(),
+					    stats.cache.AcmrAfter());
+				ImGui::Text("ATVR: %.3f -> %.3f",
+					    stats.cache.AtvrBefore(),
+					    stats.cache.AtvrAfter());
+				ImGui::Text("Meshlets: %zu", stats.meshletCount);
+				ImGui::Text("LODs generated: %zu",
+					    stats.lodCount);
+				ImGui::Text("Nodes: %zu, animations: %zu",
+					    stats.nodeCount,
+					    stats.animationCount);
+				if (ImGui::Button("Unload")) {
+					unload = model.get();
+				}
+				ImGui::TreePop();
+			}
+			ImGui::PopID();
+		}
+		if (unload) {
+			DiscardPreparedFrame();
+			_scene->InvalidateTransforms();
+			_scene->Unload(unload);
+		}
+
+		ImGui::Separator();
+		const auto pool = _scene->PoolStats();
+		ImGui::Text("Vertex pool: %.2f / %.2f MiB, %u ranges free, fragmentation %.2f",
+			    (double)pool.vertices.usedSize * pool.vertexStride /
+				    (1024.0 * 1024.0),
+			    (double)pool.vertices.capacity * pool.vertexStride /
+				    (1024.0 * 1024.0),
+			    pool.vertices.freeRangeCount,
+			    pool.vertices.Fragmentation());
+		ImGui::Text("Index pool: %.2f / %.2f MiB, %u ranges free, fragmentation %.2f",
+			    (double)pool.indices.usedSize * pool.indexSize /
+				    (1024.0 * 1024.0),
+			    (double)pool.indices.capacity * pool.indexSize /
+				    (1024.0 * 1024.0),
+			    pool.indices.freeRangeCount,
+			    pool.indices.Fragmentation());
+		ImGui::Text("Pool reallocations: %u", pool.growCount);
+
+		ImGui::Separator();
+		auto &streamer = _scene->Streamer();
+		const auto streaming = streamer.Stats();
+		// Kept in the scene info as well, so reloading the scene keeps the budget
+		auto budget = (int32_t)(_sceneInfo.streaming.budgetBytes >> 20);
+		if (ImGui::SliderInt("Texture budget (MiB)", &budget, 16, 4096)) {
+			_sceneInfo.streaming.budgetBytes = (size_t)budget << 20;
+			streamer.SetBudget(_sceneInfo.streaming.budgetBytes);
+		}
+		ImGui::Text("Resident textures: %.2f / %.2f MiB (%u textures)",
+			    streaming.residentBytes / (1024.0 * 1024.0),
+			    streaming.budgetBytes / (1024.0 * 1024.0),
+			    streaming.textureCount);
+		ImGui::Text("Budget pressure: %.2f (%.2f MiB requested)",
+			    streaming.Pressure(),
+			    streaming.requestedBytes / (1024.0 * 1024.0));
+		ImGui::Text("Pending requests: %u, uploaded %.2f MiB this frame, %u evictions",
+			    streaming.pendingRequests,
+			    streaming.uploadedBytes / (1024.0 * 1024.0),
+			    streaming.evictions);
+
+		ImGui::Separator();
+		ImGui::TextUnformatted("Hot reloads (latency from the change):");
+		for (const auto &reload : _reloads) {
+			ImGui::BulletText("%s: %.2f ms", reload.name.c_str(),
+					  reload.milliseconds);
+		}
+
+		ImGui::Separator();
+		ImGui::Checkbox("Animate", &_animate);
+		ImGui::Checkbox("Level of detail", &_lodEnabled);
+		ImGui::SliderFloat("LOD error (pixels)", &_lodErrorThreshold,
+				   0.1f, 16.0f);
+		ImGui::Text("Triangles submitted: %llu",
+			    (unsigned long long)_drawStats.triangles);
+		ImGui::Text("Draws: %u in %u draw calls", _drawStats.draws,
+			    _drawStats.drawCalls);
+		ImGui::Text("Frame time: %.3f ms (%.1f FPS average)",
+			    deltaTime * 1000.0f, ImGui::GetIO().Framerate);
 		ImGui::End();
 	}
 }
@@ -0,0 +1,58 @@
+#include <RayTracer/DrawList.h>
+
+#include <tracy/Tracy.hpp>
+
+#include <unordered_map>
+
+void BuildBatches(DrawList &drawList, DrawBatches &batches)
+{
+	ZoneScoped;
+	batches.textures.clear();
+	batches.triangles = 0;
+
+	// Split the draws in batches of at most 16 textures, each texture gets a slot in its batch
+	struct TextureSlot {
+		uint32_t batch;
+		uint32_t slot;
+	};
+	std::unordered_map<uint32_t, TextureSlot> textureSlots;
+	std::vector<uint32_t> drawBatches;
+	drawBatches.reserve(drawList.commands.size());
+	for (uint32_t i = 0; i < drawList.commands.size(); ++i) {
+		const auto texture = drawList.baseColorTextures[i];
+		auto it = textureSlots.find(texture);
+		if (it == textureSlots.end()) {
+			if (batches.textures.empty() ||
+			    batches.textures.back().size() ==
+				    TEXTURES_PER_BATCH) {
+				batches.textures.emplace_back();
+			}
+			const TextureSlot slot = {
+				(uint32_t)batches.textures.size() - 1,
+				(uint32_t)batches.textures.back().size(),
+			};
+			batches.textures.back().emplace_back(texture);
+			it = textureSlots.emplace(texture, slot).first;
+		}
+		drawList.objects[i].baseColorIndex = it->second.slot;
+		// The shader finds the object data of a draw through gl_BaseInstance
+		drawList.commands[i].baseInstance = i;
+		drawBatches.emplace_back(it->second.batch);
+		batches.triangles += drawList.commands[i].count / 3;
+	}
+
+	// Sort the commands by batch, so each batch is a contiguous range of the indirect buffer
+	batches.offsets.assign(batches.textures.size() + 1, 0);
+	for (const auto batch : drawBatches) {
+		batches.offsets[batch + 1]++;
+	}
+	for (size_t i = 1; i < batches.offsets.size(); ++i) {
+		batches.offsets[i] += batches.offsets[i - 1];
+	}
+	batches.commands.resize(drawList.commands.size());
+	auto cursors = batches.offsets;
+	for (uint32_t i = 0; i < drawList.commands.size(); ++i) {
+		batches.commands[cursors[drawBatches[i]]++] =
+			drawList.commands[i];
+	}
+}
\ No newline at end of file
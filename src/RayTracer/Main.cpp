@@ -1,8 +1,99 @@
 #include <RayTracer/App.h>
 
+#include <spdlog/spdlog.h>
+
+#include <cstdlib>
+#include <string_view>
+
+// More would only add latency, and each frame in flight keeps a fence alive
+static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 8;
+
+// Usage: RayTracer [--benchmark <frames>] [--output <path>] [--size <width> <height>] [--window]
+//                  [--metrics <path>] [--metrics-interval <seconds>]
+//                  [--capture <directory>] [--capture-format png|exr] [--frames-in-flight <n>]
+//                  [models...]
+// --benchmark renders a fixed number of frames headless, without vsync and with a fixed time step,
+// then writes the frame timings to <path>.csv and <path>.json ("benchmark" by default).
+// --window runs the benchmark in a visible window instead.
+// --metrics writes the counters and timers recorded over the last interval (10 s by default) to
+// <path> as JSON, replacing it every interval.
+// --capture writes every frame to <directory> as frame_000000.png (or .exr). Interactively frames
+// are dropped when the writers fall behind, a benchmark waits for them so the sequence is complete.
+// --frames-in-flight caps how far the CPU runs ahead of the GPU (2 by default, at most 8), 1 turns
+// off the preparation of the next frame during this one's submission, for the lowest latency.
 int main(int argc, char *argv[])
 {
-	App application;
+	BaseAppOptions options;
+	// Optionally takes the paths of the glTF models to display
+	std::vector<std::string> modelPaths;
+	bool window = false;
+	for (int i = 1; i < argc; ++i) {
+		const std::string_view argument = argv[i];
+		if (argument == "--benchmark" && i + 1 < argc) {
+			options.frameCount = std::strtoull(argv[++i], nullptr, 10);
+		} else if (argument == "--output" && i + 1 < argc) {
+			options.benchmarkOutput = argv[++i];
+		} else if (argument == "--size" && i + 2 < argc) {
+			options.width = std::atoi(argv[++i]);
+			options.height = std::atoi(argv[++i]);
+		} else if (argument == "--metrics" && i + 1 < argc) {
+			options.metricsOutput = argv[++i];
+		} else if (argument == "--metrics-interval" && i + 1 < argc) {
+			options.metricsInterval = std::atof(argv[++i]);
+		} else if (argument == "--capture" && i + 1 < argc) {
+			options.captureDirectory = argv[++i];
+		} else if (argument == "--capture-format" && i + 1 < argc) {
+			const std::string_view format = argv[++i];
+			if (format == "png") {
+				options.captureFormat = CaptureFormat::PNG;
+			} else if (format == "exr") {
+				options.captureFormat = CaptureFormat::EXR;
+			} else {
+				spdlog::error("Unknown capture format {}", format);
+				return 1;
+			}
+		} else if (argument == "--frames-in-flight" && i + 1 < argc) {
+			// strtoul wraps negative numbers around, only plain digits are taken
+			const char *value = argv[++i];
+			char *end = nullptr;
+			const auto frames = std::strtoul(value, &end, 10);
+			if (*value < '0' || *value > '9' || *end != '\0' ||
+			    frames == 0 || frames > MAX_FRAMES_IN_FLIGHT) {
+				spdlog::error("Invalid frames in flight {}, expected 1 to {}",
+					      value, MAX_FRAMES_IN_FLIGHT);
+				return 1;
+			}
+			options.maxFramesInFlight = (uint32_t)frames;
+		} else if (argument == "--window") {
+			window = true;
+		} else if (argument.starts_with("--")) {
+			spdlog::error("Unknown option {}", argument);
+			return 1;
+		} else {
+			modelPaths.emplace_back(argument);
+		}
+	}
+	if (options.frameCount > 0) {
+		options.headless = !window;
+		options.vsync = false;
+		options.fixedDeltaTime = 1.0 / 60.0;
+		options.captureEveryFrame = true;
+		if (options.benchmarkOutput.empty()) {
+			options.benchmarkOutput = "benchmark";
+		}
+	}
+	if (options.metricsInterval <= 0.0) {
+		spdlog::error("Invalid metrics interval {}",
+			      options.metricsInterval);
+		return 1;
+	}
+	if (options.width <= 0 || options.height <= 0) {
+		spdlog::error("Invalid size {}x{}", options.width,
+			      options.height);
+		return 1;
+	}
+
+	App application(std::move(modelPaths), options);
 	application.Run();
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,65 @@
+#include <tracy/Tracy.hpp>
+
+#include <cstdlib>
+#include <new>
+
+// Reports every allocation to Tracy, so its memory view shows where our memory goes.
+// The array, nothrow and sized versions of the standard library all end up in these, those
+// taking a std::align_val_t (types aligned above the default, like SIMD data) in the aligned ones.
+// Allocations can happen after the profiler is gone (static destructors), hence the secure versions.
+#ifdef TRACY_ENABLE
+void *operator new(std::size_t size)
+{
+	auto *pointer = std::malloc(size ? size : 1);
+	if (!pointer) {
+		throw std::bad_alloc();
+	}
+	TracySecureAlloc(pointer, size);
+	return pointer;
+}
+
+void operator delete(void *pointer) noexcept
+{
+	TracySecureFree(pointer);
+	std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept
+{
+	TracySecureFree(pointer);
+	std::free(pointer);
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment)
+{
+	const auto align = static_cast<std::size_t>(alignment);
+	// aligned_alloc wants a multiple of the alignment, Windows has its own aligned heap
+	const auto alignedSize = ((size ? size : 1) + align - 1) & ~(align - 1);
+#ifdef _WIN32
+	auto *pointer = _aligned_malloc(alignedSize, align);
+#else
+	auto *pointer = std::aligned_alloc(align, alignedSize);
+#endif
+	if (!pointer) {
+		throw std::bad_alloc();
+	}
+	TracySecureAlloc(pointer, size);
+	return pointer;
+}
+
+void operator delete(void *pointer, std::align_val_t) noexcept
+{
+	TracySecureFree(pointer);
+#ifdef _WIN32
+	_aligned_free(pointer);
+#else
+	std::free(pointer);
+#endif
+}
+
+void operator delete(void *pointer, std::size_t,
+		     std::align_val_t alignment) noexcept
+{
+	operator delete(pointer, alignment);
+}
+#endif
\ No newline at end of file
@@ -1,22 +1,104 @@
 #include <RayTracer/Mesh.h>
 
 #include <glad/glad.h>
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+// Maps a unit vector onto the [-1, 1] square (octahedral encoding)
+static glm::vec2 OctahedralEncode(const glm::vec3 &n)
+{
+	const auto length = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+	// Missing attributes are zero, they decode to +Z
+	if (length == 0.0f) {
+		return glm::vec2(0.0f);
+	}
+	const auto p = n / length;
+	if (p.z >= 0.0f) {
+		return glm::vec2(p.x, p.y);
+	}
+	// Fold the lower hemisphere over the diagonals
+	return glm::vec2((1.0f - std::abs(p.y)) * (p.x >= 0.0f ? 1.0f : -1.0f),
+			 (1.0f - std::abs(p.x)) * (p.y >= 0.0f ? 1.0f : -1.0f));
+}
+
+static int16_t QuantizeSnorm16(float value)
+{
+	return (int16_t)std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f);
+}
+
+static uint16_t QuantizeUnorm16(float value)
+{
+	return (uint16_t)std::lround(std::clamp(value, 0.0f, 1.0f) * 65535.0f);
+}
+
+CompactVertex PackVertex(const Vertex &vertex, const glm::vec3 &boundsMin,
+			 const glm::vec3 &boundsMax)
+{
+	const auto extent = boundsMax - boundsMin;
+	// Flat meshes have a zero extent on one axis, every vertex sits on the minimum there
+	const auto relative = glm::vec3(
+		extent.x > 0.0f ? (vertex.position.x - boundsMin.x) / extent.x :
+				  0.0f,
+		extent.y > 0.0f ? (vertex.position.y - boundsMin.y) / extent.y :
+				  0.0f,
+		extent.z > 0.0f ? (vertex.position.z - boundsMin.z) / extent.z :
+				  0.0f);
+	const auto normal = OctahedralEncode(vertex.normal);
+	const auto tangent = OctahedralEncode(glm::vec3(vertex.tangent));
+
+	CompactVertex result = {};
+	result.position[0] = QuantizeUnorm16(relative.x);
+	result.position[1] = QuantizeUnorm16(relative.y);
+	result.position[2] = QuantizeUnorm16(relative.z);
+	// The bitangent sign is stored as 0 (-1) or 1 (+1)
+	result.position[3] = vertex.tangent.w < 0.0f ? 0 : 65535;
+	result.normal[0] = QuantizeSnorm16(normal.x);
+	result.normal[1] = QuantizeSnorm16(normal.y);
+	result.tangent[0] = QuantizeSnorm16(tangent.x);
+	result.tangent[1] = QuantizeSnorm16(tangent.y);
+	result.uv[0] = glm::packHalf1x16(vertex.uv.x);
+	result.uv[1] = glm::packHalf1x16(vertex.uv.y);
+	return result;
+}
 
 Mesh::Mesh(const MeshCreateInfo &info)
 {
-	_indexCount = info.indices.size();
-	_vertexOffset = info.vertexOffset / sizeof(Vertex);
-	_indexOffset = info.indexOffset / sizeof(uint32_t);
+	_vertexOffset = info.vertexOffset / info.vertexStride;
+	// The levels of detail are stored one after the other, starting with the full mesh
+	uint32_t firstIndex = info.indexOffset / info.indexSize;
+	_lods[_lodCount++] = { firstIndex, (uint32_t)info.indices.size(),
+			       0.0f };
+	firstIndex += info.indices.size();
+	for (const auto &lod : info.lods) {
+		if (_lodCount == MAX_LODS) {
+			break;
+		}
+		_lods[_lodCount++] = { firstIndex,
+				       (uint32_t)lod.indices.size(),
+				       lod.error };
+		firstIndex += lod.indices.size();
+	}
 	_transformIndex = info.transformIndex;
 	_baseColorTexture = info.baseColorTexture;
 	_normalTexture = info.normalTexture;
+	_format = info.vertexFormat;
+	_meshletCount = info.meshletCount;
+	_boundsCenter = (info.boundsMin + info.boundsMax) * 0.5f;
+	_boundsRadius = glm::length(info.boundsMax - info.boundsMin) * 0.5f;
+	if (_format == VertexFormat::Compact) {
+		_positionOffset = info.boundsMin;
+		_positionScale = info.boundsMax - info.boundsMin;
+	}
 }
 
 Mesh::~Mesh() = default;
 
-MeshIndirectInfo Mesh::Info() const
+MeshIndirectInfo Mesh::Info(uint32_t lod) const
 {
-	return { _indexCount, 1, _indexOffset, _vertexOffset, 1 };
+	const auto &range = _lods[std::min(lod, _lodCount - 1)];
+	return { range.indexCount, 1, range.firstIndex, _vertexOffset, 1 };
 }
 
 uint32_t Mesh::TransformIndex() const
@@ -32,4 +114,54 @@ uint32_t Mesh::BaseColorTexture() const
 uint32_t Mesh::NormalTexture() const
 {
 	return _normalTexture;
+}
+
+void Mesh::SetTransformIndex(uint32_t transformIndex)
+{
+	_transformIndex = transformIndex;
+}
+
+void Mesh::SetBaseColorTexture(uint32_t baseColorTexture)
+{
+	_baseColorTexture = baseColorTexture;
+}
+
+VertexFormat Mesh::Format() const
+{
+	return _format;
+}
+
+glm::vec3 Mesh::PositionOffset() const
+{
+	return _positionOffset;
+}
+
+glm::vec3 Mesh::PositionScale() const
+{
+	return _positionScale;
+}
+
+uint32_t Mesh::MeshletCount() const
+{
+	return _meshletCount;
+}
+
+uint32_t Mesh::LodCount() const
+{
+	return _lodCount;
+}
+
+const MeshLodRange &Mesh::Lod(uint32_t lod) const
+{
+	return _lods[lod];
+}
+
+glm::vec3 Mesh::BoundsCenter() const
+{
+	return _boundsCenter;
+}
+
+float Mesh::BoundsRadius() const
+{
+	return _boundsRadius;
 }
\ No newline at end of file
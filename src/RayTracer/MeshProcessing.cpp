@@ -0,0 +1,244 @@
+#include <RayTracer/MeshProcessing.h>
+
+#include <meshoptimizer.h>
+
+#include <algorithm>
+#include <limits>
+
+// FIFO cache size used when measuring, a conservative figure for current GPUs
+static constexpr uint32_t CACHE_SIZE = 16;
+// Meshlet limits, these match what mesh shading hardware prefers
+static constexpr size_t MAX_MESHLET_VERTICES = 64;
+static constexpr size_t MAX_MESHLET_TRIANGLES = 124;
+static constexpr float MESHLET_CONE_WEIGHT = 0.25f;
+// A level that removes less than this fraction of the previous one isn't worth keeping
+static constexpr float MIN_LOD_REDUCTION = 0.1f;
+// How much the vertex cache efficiency may degrade in favour of less overdraw
+static constexpr float OVERDRAW_THRESHOLD = 1.05f;
+
+float MeshCacheStats::AcmrBefore() const
+{
+	return triangleCount ? (float)transformedBefore / triangleCount : 0.0f;
+}
+
+float MeshCacheStats::AcmrAfter() const
+{
+	return triangleCount ? (float)transformedAfter / triangleCount : 0.0f;
+}
+
+float MeshCacheStats::AtvrBefore() const
+{
+	return vertexCount ? (float)transformedBefore / vertexCount : 0.0f;
+}
+
+float MeshCacheStats::AtvrAfter() const
+{
+	return vertexCount ? (float)transformedAfter / vertexCount : 0.0f;
+}
+
+MeshCacheStats &MeshCacheStats::operator+=(const MeshCacheStats &other)
+{
+	triangleCount += other.triangleCount;
+	vertexCount += other.vertexCount;
+	transformedBefore += other.transformedBefore;
+	transformedAfter += other.transformedAfter;
+	return *this;
+}
+
+static void BuildMeshlets(const std::vector<Vertex> &vertices,
+			  const std::vector<uint32_t> &indices,
+			  MeshletData &result)
+{
+	const auto maxMeshlets = meshopt_buildMeshletsBound(
+		indices.size(), MAX_MESHLET_VERTICES, MAX_MESHLET_TRIANGLES);
+	std::vector<meshopt_Meshlet> meshlets(maxMeshlets);
+	result.vertices.resize(maxMeshlets * MAX_MESHLET_VERTICES);
+	result.triangles.resize(maxMeshlets * MAX_MESHLET_TRIANGLES * 3);
+	const auto meshletCount = meshopt_buildMeshlets(
+		meshlets.data(), result.vertices.data(),
+		result.triangles.data(), indices.data(), indices.size(),
+		&vertices[0].position.x, vertices.size(), sizeof(Vertex),
+		MAX_MESHLET_VERTICES, MAX_MESHLET_TRIANGLES,
+		MESHLET_CONE_WEIGHT);
+	if (meshletCount == 0) {
+		result = {};
+		return;
+	}
+
+	// The output is sized for the worst case, trim it down to what was actually written
+	const auto &last = meshlets[meshletCount - 1];
+	result.vertices.resize(last.vertex_offset + last.vertex_count);
+	// Each meshlet's triangles start on a 4 byte boundary
+	result.triangles.resize(last.triangle_offset +
+				((last.triangle_count * 3 + 3) & ~3u));
+
+	result.meshlets.clear();
+	result.meshlets.reserve(meshletCount);
+	for (size_t i = 0; i < meshletCount; ++i) {
+		const auto &meshlet = meshlets[i];
+		const auto bounds = meshopt_computeMeshletBounds(
+			&result.vertices[meshlet.vertex_offset],
+			&result.triangles[meshlet.triangle_offset],
+			meshlet.triangle_count, &vertices[0].position.x,
+			vertices.size(), sizeof(Vertex));
+		result.meshlets.emplace_back(Meshlet{
+			meshlet.vertex_offset,
+			meshlet.triangle_offset,
+			meshlet.vertex_count,
+			meshlet.triangle_count,
+			glm::vec3(bounds.center[0], bounds.center[1],
+				  bounds.center[2]),
+			bounds.radius,
+			glm::vec3(bounds.cone_apex[0], bounds.cone_apex[1],
+				  bounds.cone_apex[2]),
+			glm::vec3(bounds.cone_axis[0], bounds.cone_axis[1],
+				  bounds.cone_axis[2]),
+			bounds.cone_cutoff,
+		});
+	}
+}
+
+MeshCacheStats OptimizeMesh(std::vector<Vertex> &vertices,
+			    std::vector<uint32_t> &indices,
+			    MeshletData &meshlets,
+			    const MeshOptimizeOptions &options)
+{
+	MeshCacheStats stats;
+	if (indices.empty() || vertices.empty()) {
+		return stats;
+	}
+
+	stats.triangleCount = indices.size() / 3;
+	stats.transformedBefore =
+		meshopt_analyzeVertexCache(indices.data(), indices.size(),
+					   vertices.size(), CACHE_SIZE, 0, 0)
+			.vertices_transformed;
+
+	if (options.optimize) {
+		std::vector<uint32_t> reordered(indices.size());
+		// Reorder triangles so vertices that were just transformed get reused
+		meshopt_optimizeVertexCache(reordered.data(), indices.data(),
+					    indices.size(), vertices.size());
+		// Then reorder clusters of triangles front to back, to reduce overdraw
+		meshopt_optimizeOverdraw(indices.data(), reordered.data(),
+					 indices.size(),
+					 &vertices[0].position.x,
+					 vertices.size(), sizeof(Vertex),
+					 OVERDRAW_THRESHOLD);
+		// Finally reorder the vertices in the order they are first referenced,
+		// this also drops vertices that no triangle uses
+		std::vector<Vertex> fetchOrdered(vertices.size());
+		const auto vertexCount = meshopt_optimizeVertexFetch(
+			fetchOrdered.data(), indices.data(), indices.size(),
+			vertices.data(), vertices.size(), sizeof(Vertex));
+		fetchOrdered.resize(vertexCount);
+		vertices = std::move(fetchOrdered);
+	}
+	// Counted once unused vertices are dropped, they are never transformed
+	stats.vertexCount = vertices.size();
+
+	stats.transformedAfter =
+		meshopt_analyzeVertexCache(indices.data(), indices.size(),
+					   vertices.size(), CACHE_SIZE, 0, 0)
+			.vertices_transformed;
+
+	if (options.buildMeshlets) {
+		BuildMeshlets(vertices, indices, meshlets);
+	}
+	return stats;
+}
+
+std::vector<MeshLod> BuildLods(const std::vector<Vertex> &vertices,
+			       const std::vector<uint32_t> &indices,
+			       const MeshLodOptions &options)
+{
+	std::vector<MeshLod> lods;
+	if (indices.empty() || vertices.empty()) {
+		return lods;
+	}
+
+	// meshopt reports errors relative to the mesh extent, this turns them into object space
+	const auto errorScale = meshopt_simplifyScale(
+		&vertices[0].position.x, vertices.size(), sizeof(Vertex));
+	auto previousCount = indices.size();
+	auto targetCount = (float)indices.size();
+	for (uint32_t level = 1; level < options.maxLods; ++level) {
+		targetCount *= options.reduction;
+		// Always simplify the full resolution mesh, so every error is measured against it
+		std::vector<uint32_t> simplified(indices.size());
+		float error = 0.0f;
+		const auto count = meshopt_simplify(
+			simplified.data(), indices.data(), indices.size(),
+			&vertices[0].position.x, vertices.size(),
+			sizeof(Vertex), (size_t)targetCount / 3 * 3,
+			options.maxError, 0, &error);
+		if (count == 0 ||
+		    count > previousCount * (1.0f - MIN_LOD_REDUCTION)) {
+			break;
+		}
+		simplified.resize(count);
+		// Simplification scrambles the triangle order, restore vertex cache locality
+		meshopt_optimizeVertexCache(simplified.data(), simplified.data(),
+					    simplified.size(), vertices.size());
+		lods.emplace_back(MeshLod{ std::move(simplified),
+					   error * errorScale });
+		previousCount = count;
+	}
+	return lods;
+}
+
+// A part of `mesh` without vertices nor indices yet, only the fields describing the mesh are copied
+static MeshCreateInfo EmptyPart(const MeshCreateInfo &mesh)
+{
+	MeshCreateInfo part = {};
+	part.transformIndex = mesh.transformIndex;
+	part.baseColorTexture = mesh.baseColorTexture;
+	part.normalTexture = mesh.normalTexture;
+	part.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+	part.boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+	part.vertexFormat = mesh.vertexFormat;
+	part.vertexStride = mesh.vertexStride;
+	part.indexSize = mesh.indexSize;
+	return part;
+}
+
+std::vector<MeshCreateInfo> SplitMesh(const MeshCreateInfo &mesh,
+				      uint32_t maxVertices)
+{
+	std::vector<MeshCreateInfo> parts;
+	// Index of each source vertex in the current part, NO_VERTEX when it isn't in it yet
+	static constexpr uint32_t NO_VERTEX = UINT32_MAX;
+	std::vector<uint32_t> remap(mesh.vertices.size(), NO_VERTEX);
+	MeshCreateInfo *part = nullptr;
+	// First source index of the current part
+	size_t partStart = 0;
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+		uint32_t added = 0;
+		for (size_t j = i; j < i + 3; ++j) {
+			added += remap[mesh.indices[j]] == NO_VERTEX;
+		}
+		// Start a new part when the triangle's new vertices don't fit in this one
+		if (!part || part->vertices.size() + added > maxVertices) {
+			// Only the vertices of the finished part were remapped
+			for (size_t j = partStart; j < i; ++j) {
+				remap[mesh.indices[j]] = NO_VERTEX;
+			}
+			partStart = i;
+			part = &parts.emplace_back(EmptyPart(mesh));
+		}
+		for (size_t j = i; j < i + 3; ++j) {
+			auto &index = remap[mesh.indices[j]];
+			if (index == NO_VERTEX) {
+				const auto &vertex = mesh.vertices[mesh.indices[j]];
+				index = part->vertices.size();
+				part->vertices.emplace_back(vertex);
+				part->boundsMin =
+					glm::min(part->boundsMin, vertex.position);
+				part->boundsMax =
+					glm::max(part->boundsMax, vertex.position);
+			}
+			part->indices.emplace_back(index);
+		}
+	}
+	return parts;
+}
\ No newline at end of file
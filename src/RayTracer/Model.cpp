@@ -1,483 +1,622 @@
 #include <RayTracer/Model.h>
 
-// #define STB_IMAGE_IMPLEMENTATION
-// #define CGLTF_IMPLEMENTATION
+#include <RayTracer/ModelImport.h>
+
+#include <RayTracerLib/FileWatcher.hpp>
+#include <RayTracerLib/Hash.hpp>
+#include <RayTracerLib/Metrics.hpp>
+#include <RayTracerLib/Parallel.hpp>
+#include <RayTracerLib/TextureCache.hpp>
 
 #include <glad/glad.h>
 #include <stb_image.h>
-#include <cgltf.h>
 #include <glm/gtc/type_ptr.hpp>
+#include <spdlog/spdlog.h>
+#include <tracy/Tracy.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
 #include <cstdint>
 #include <cstring>
-#include <filesystem>
+#include <iterator>
+#include <limits>
 #include <unordered_map>
-#include <queue>
-#include <set>
 
 namespace fs = std::filesystem;
 
-// Helper function to find the actual texture path given a CGLTF image.
-static std::string FindTexturePath(const fs::path &basePath,
-				   const cgltf_image *image)
+// Distances are clamped to this when projecting errors, so the camera being inside a mesh is well defined
+static constexpr float NEAR_DISTANCE = 0.1f;
+// Most vertices a mesh drawn with 16-bit indices can have
+static constexpr uint32_t MAX_SHORT_INDEX_VERTICES = 65536;
+
+void Model::LoadTextures(const std::vector<std::string> &paths)
 {
-	std::string texturePath;
-	if (!image->uri) {
-		auto newPath = basePath / image->name;
-		if (!newPath.has_extension()) {
-			if (std::strcmp(image->mime_type, "image/png") == 0) {
-				newPath.replace_extension("png");
-			} else if (std::strcmp(image->mime_type, "image/jpg") ==
-				   0) {
-				newPath.replace_extension("jpg");
-			}
-		}
-		texturePath = newPath.generic_string();
-	} else {
-		texturePath = (basePath / image->uri).generic_string();
+	ZoneScoped;
+	static const MetricTimer loadTimer("model.textures");
+	static const MetricTimer encodeTimer("model.texture_encode");
+	static const MetricCounter cacheHitCounter("model.texture_cache_hits");
+	const auto loadStart = std::chrono::steady_clock::now();
+	auto format = _options.textureFormat;
+	if (!IsTextureFormatSupported(format)) {
+		spdlog::warn(
+			"Model: Texture format {} is not supported, using RGBA8",
+			(uint32_t)format);
+		format = TextureFormat::RGBA8;
 	}
-	return texturePath;
-}
+	const TextureCache cache(_options.textureCacheDirectory);
+	const bool useCache = !_options.textureCacheDirectory.empty();
+
+	// Everything we learn about a texture before uploading it
+	struct TextureLoad {
+		TextureData data;
+		uint64_t key = 0;
+		// Same content as the texture we already have for this path
+		bool unchanged = false;
+		bool cacheHit = false;
+		// Textures we couldn't decode are replaced by a white texel, we don't cache those
+		bool decoded = false;
+		// Streamed textures read their fine levels back from the cache file
+		bool streamed = false;
+	};
 
-Model::Model(std::string_view file)
-{
-	cgltf_options options = {};
-	cgltf_data *model = nullptr;
-	// Read GLTF, no additional options are required
-	cgltf_parse_file(&options, file.data(), &model);
-	// Load all GLTF buffers
-	cgltf_load_buffers(&options, model, file.data());
-
-	// Get the base path (useful when loading textures)
-	fs::path path(file.data());
-	const auto basePath = path.parent_path();
-	// This is our texture cache, to make sure we don't load the same texture twice
-	std::unordered_map<std::string, size_t> textureIds;
-	// Reserves space for our texture vector
-	_textures.reserve(model->materials_count);
-	// Since we'll be batching our draws based on the textures it has, we need to calculate
-	// how many batches this model needs, this is done by dividing by 16, which is the "batch size"
-	// and rounding up, because we always need at least one batch.
-	const uint32_t maxBatches = model->materials_count / 16 + 1;
-	for (uint32_t i = 0; i < model->materials_count;
-	     ++i) // For each material
-	{
-		const auto &material = model->materials[i];
-		// Get the material's base color texture
-		const auto *image = material.pbr_metallic_roughness
-					    .base_color_texture.texture->image;
-		// Find its texture path
-		const auto texturePath = FindTexturePath(basePath, image);
-		if (textureIds.contains(texturePath)) {
-			// If we already loaded the texture, go onto the next material
-			continue;
+	// Read, hash, look up in the cache and (on a miss) decode and build mips, every texture is independent
+	std::vector<TextureLoad> textures(paths.size());
+	ParallelFor(paths.size(), [&](size_t i) {
+		ZoneScopedN("Model: Read texture");
+		ZoneText(paths[i].c_str(), paths[i].size());
+		auto &texture = textures[i];
+		std::vector<uint8_t> file;
+		if (!ReadFile(paths[i], file)) {
+			spdlog::error("Model: Unable to read texture {}",
+				      paths[i]);
+		}
+		// The key covers the source image and everything that changes the encoded result
+		texture.key = HashCombine(HashBytes(file.data(), file.size()),
+					  (uint64_t)format);
+		const auto current = _textureEntries.find(paths[i]);
+		if (current != _textureEntries.end() &&
+		    current->second.key == texture.key) {
+			texture.unchanged = true;
+			return;
+		}
+		// Only the levels the streamer starts with are read, the loader reads the others when they're needed
+		if (useCache && cache.LoadCoarse(texture.key,
+						 _streamer.InitialSize(),
+						 texture.data)) {
+			texture.cacheHit = true;
+			texture.streamed = true;
+			return;
 		}
-		// Ask OpenGL to give us a new texture handle
-		uint32_t texture;
-		glCreateTextures(GL_TEXTURE_2D, 1, &texture);
-
-		// Sets the texture's sampler's parameters
-		// if you are not familiar with these, LearnOpenGL.com has a great tutorial
-		glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER,
-				    GL_LINEAR_MIPMAP_LINEAR);
-		glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
 		// Loads the texture data with STB_Image
 		int32_t width = 0;
 		int32_t height = 0;
 		int32_t channels = STBI_rgb_alpha;
-		const auto *textureData = stbi_load(texturePath.c_str(), &width,
-						    &height, &channels,
-						    STBI_rgb_alpha);
-		// Calculate how many mip levels we need to generate for the texture.
-		const auto levels = (uint32_t)std::floor(
-			std::log2(std::max(width, height)));
-		// Actually allocate the texture
-		glTextureStorage2D(texture, levels, GL_RGBA8, width, height);
-		// Copy our texture data to the GPU
-		glTextureSubImage2D(texture, 0, 0, 0, width, height, GL_RGBA,
-				    GL_UNSIGNED_BYTE, textureData);
-		// Generate mipmaps
-		glGenerateTextureMipmap(texture);
+		auto *textureData = stbi_load_from_memory(
+			file.data(), file.size(), &width, &height, &channels,
+			STBI_rgb_alpha);
+		if (!textureData) {
+			// Missing textures are drawn white instead of crashing
+			spdlog::error("Model: Unable to decode texture {}",
+				      paths[i]);
+			const uint8_t white[4] = { 255, 255, 255, 255 };
+			texture.data = BuildMipChain(white, 1, 1);
+			return;
+		}
+		texture.data = BuildMipChain(textureData, width, height);
+		texture.decoded = true;
 		// Free texture memory on our end
-		stbi_image_free((void *)textureData);
-		// Add the new texture handle to the texture vector
-		_textures.emplace_back(texture);
-		// Register this texture index in our cache
-		textureIds[texturePath] = _textures.size() - 1;
+		stbi_image_free(textureData);
+	});
+
+	// Compress the misses, each texture is spread over every thread on its own
+	_stats.textureCacheHits = 0;
+	_stats.encodedTexels = 0;
+	const auto encodeStart = std::chrono::steady_clock::now();
+	for (auto &texture : textures) {
+		if (texture.cacheHit) {
+			++_stats.textureCacheHits;
+			continue;
+		}
+		if (!texture.decoded) {
+			continue;
+		}
+		ZoneScopedN("Model: Compress texture");
+		if (format != TextureFormat::RGBA8) {
+			for (const auto &level : texture.data.levels) {
+				_stats.encodedTexels +=
+					(size_t)level.width * level.height;
+			}
+			texture.data = CompressTexture(texture.data, format);
+		}
+		// Textures we can't cache can't be streamed, they stay fully resident
+		texture.streamed = useCache &&
+				   cache.Store(texture.key, texture.data);
+	}
+	_stats.encodeMilliseconds =
+		std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - encodeStart)
+			.count();
+	cacheHitCounter.Add(_stats.textureCacheHits);
+	if (_stats.encodedTexels > 0) {
+		encodeTimer.Record(_stats.encodeMilliseconds);
 	}
 
-	uint32_t transformIndex = 0;
-	size_t vertexOffset = 0;
-	size_t indexOffset = 0;
-	std::vector<MeshCreateInfo> meshCreateInfos;
-	meshCreateInfos.reserve(1024);
-	// For each node in the scene
-	for (uint32_t i = 0; i < model->scene->nodes_count; ++i) {
-		std::queue<cgltf_node *> nodes;
-		// Add the node to the queue (Exercise: can you use recursion instead of a queue?)
-		nodes.push(model->scene->nodes[i]);
-		while (!nodes.empty()) {
-			// Get a node from the queue
-			const auto *node = nodes.front();
-			nodes.pop();
-			// If there are no meshes
-			if (!node->mesh) {
-				// Then for each node (if any)
-				for (uint32_t j = 0; j < node->children_count;
-				     ++j) {
-					// Add it to the queue again
-					nodes.push(node->children[j]);
-				}
-				continue;
-			}
-			// For each primitive in the node
-			for (uint32_t j = 0; j < node->mesh->primitives_count;
-			     ++j) {
-				const auto &primitive =
-					node->mesh->primitives[j];
-				const glm::vec3 *positionPtr = nullptr;
-				const glm::vec3 *normalPtr = nullptr;
-				const glm::vec2 *uvPtr = nullptr;
-				const glm::vec4 *tangentPtr = nullptr;
-				uint64_t vertexCount = 0;
-				// Get its vertex data
-				for (uint32_t k = 0;
-				     k < primitive.attributes_count; ++k) {
-					// Get the attribute information (position, normal, ...)
-					const auto &attribute =
-						primitive.attributes[k];
-					const auto *accessor = attribute.data;
-					// Get the buffer view associated with this attribute
-					const auto *view =
-						accessor->buffer_view;
-					const auto *dataPtr =
-						(const char *)view->buffer->data;
-					// If this is confusing you can refer to the glTF main scheme by Khronos, it should clear up some things
-					switch (attribute.type) {
-					case cgltf_attribute_type_position:
-						vertexCount = accessor->count;
-						// Set the `positionPtr`
-						positionPtr =
-							(const glm::vec3
-								 *)(dataPtr +
-								    view->offset +
-								    accessor->offset);
-						break;
-
-					case cgltf_attribute_type_normal:
-						// Set the `normalPtr`
-						normalPtr =
-							(const glm::vec3
-								 *)(dataPtr +
-								    view->offset +
-								    accessor->offset);
-						break;
-
-					case cgltf_attribute_type_texcoord:
-						// Set the `uvPtr`
-						uvPtr = (const glm::vec2
-								 *)(dataPtr +
-								    view->offset +
-								    accessor->offset);
-						break;
-
-					case cgltf_attribute_type_tangent:
-						// Set the `tangentPtr`
-						tangentPtr =
-							(const glm::vec4
-								 *)(dataPtr +
-								    view->offset +
-								    accessor->offset);
-						break;
-
-					default:
-						break;
-					}
-				}
-				// Reserve space for the vertices in our own vertex format
-				std::vector<Vertex> vertices;
-				vertices.resize(vertexCount);
-				{
-					// Get the pointer to the base of the vector
-					auto *ptr = vertices.data();
-					// For each vertex
-					for (uint32_t v = 0; v < vertexCount;
-					     ++v, ++ptr) {
-						// Copy the attribute (if available) to the current pointer (will increment every iteration)
-						if (positionPtr) {
-							std::memcpy(
-								&ptr->position,
-								positionPtr + v,
-								sizeof(glm::vec3));
-						}
-						if (normalPtr) {
-							std::memcpy(
-								&ptr->normal,
-								normalPtr + v,
-								sizeof(glm::vec3));
-						}
-						if (uvPtr) {
-							std::memcpy(
-								&ptr->uv,
-								uvPtr + v,
-								sizeof(glm::vec2));
-						}
-						if (tangentPtr) {
-							std::memcpy(
-								&ptr->tangent,
-								tangentPtr + v,
-								sizeof(glm::vec4));
-						}
-					}
-				}
-
-				std::vector<uint32_t> indices;
-				{
-					// Get the indices information for the primitive
-					const auto *accessor =
-						primitive.indices;
-					const auto *view =
-						accessor->buffer_view;
-					const char *dataPtr =
-						(const char *)view->buffer->data;
-					// Reserve space for our indices buffer
-					indices.reserve(accessor->count);
-					// Check the index type (uint8, uint16 or uin32)
-					switch (accessor->component_type) {
-					// Copy the whole index buffer to our vector
-					case cgltf_component_type_r_8:
-					case cgltf_component_type_r_8u: {
-						const auto *ptr =
-							(const uint8_t
-								 *)(dataPtr +
-								    view->offset +
-								    accessor->offset);
-						std::copy(ptr,
-							  ptr + accessor->count,
-							  std::back_inserter(
-								  indices));
-					} break;
-
-					case cgltf_component_type_r_16:
-					case cgltf_component_type_r_16u: {
-						const auto *ptr =
-							(const uint16_t
-								 *)(dataPtr +
-								    view->offset +
-								    accessor->offset);
-						std::copy(ptr,
-							  ptr + accessor->count,
-							  std::back_inserter(
-								  indices));
-					} break;
-
-					case cgltf_component_type_r_32f:
-					case cgltf_component_type_r_32u: {
-						const auto *ptr =
-							(const uint32_t
-								 *)(dataPtr +
-								    view->offset +
-								    accessor->offset);
-						std::copy(ptr,
-							  ptr + accessor->count,
-							  std::back_inserter(
-								  indices));
-					} break;
-
-					default:
-						break;
-					}
-				}
-				// Get the primitive's material base color texture path
-				const auto baseColorURI = FindTexturePath(
-					basePath,
-					primitive.material
-						->pbr_metallic_roughness
-						.base_color_texture.texture
-						->image);
-				const auto indexCount = indices.size();
-				// Emplace a `MeshCreateInfo` (we will use this later)
-				meshCreateInfos.emplace_back(MeshCreateInfo{
-					std::move(vertices),
-					std::move(indices),
-					transformIndex++,
-					// Exercise: this doesn't handle missing textures, it's possible that a mesh may not have any color
-					// texture, can you change this behavior and display a default texture of your choice when this happens?
-					(uint32_t)textureIds[baseColorURI],
-					// Exercise: We don't load normal textures, can you load the normal textures (when available)
-					// and apply some basic normal mapping?
-					0,
-					vertexOffset,
-					indexOffset,
-				});
-				// Apply the node transformation and emplace it to the vector
-				cgltf_node_transform_world(
-					node,
-					glm::value_ptr(
-						_transforms.emplace_back()));
-				// Increment the vertex and index byte offset
-				vertexOffset += vertexCount * sizeof(Vertex);
-				indexOffset += indexCount * sizeof(uint32_t);
+	// Finally hand everything to the streamer, which uploads the coarse levels and reads the
+	// others from the cache file when they are needed. This has to happen on the thread owning the context.
+	std::unordered_map<std::string, TextureEntry> entries;
+	_textures.clear();
+	_stats.textureBytes = 0;
+	_stats.uncompressedTextureBytes = 0;
+	for (size_t i = 0; i < textures.size(); ++i) {
+		ZoneScopedN("Model: Upload texture");
+		const auto &texture = textures[i];
+		auto current = _textureEntries.find(paths[i]);
+		if (texture.unchanged) {
+			_lastReload.texturesReused++;
+		} else {
+			// The content changed, the texture is replaced
+			if (current != _textureEntries.end()) {
+				_streamer.Release(current->second.id);
+				_textureEntries.erase(current);
 			}
-			// Push children nodes
-			for (uint32_t j = 0; j < node->children_count; ++j) {
-				nodes.push(node->children[j]);
+			TextureEntry entry = { texture.key, 0, 0, 0 };
+			for (const auto &level : texture.data.levels) {
+				entry.bytes += TextureLevelSize(
+					texture.data.format, level.width,
+					level.height);
+				entry.uncompressedBytes += TextureLevelSize(
+					TextureFormat::RGBA8, level.width,
+					level.height);
 			}
+			entry.id = _streamer.Add(
+				texture.data, texture.streamed ?
+						      cache.PathFor(texture.key) :
+						      fs::path());
+			current = _textureEntries.emplace(paths[i], entry).first;
+			_lastReload.texturesLoaded++;
 		}
+		const auto &entry = current->second;
+		_stats.textureBytes += entry.bytes;
+		_stats.uncompressedTextureBytes += entry.uncompressedBytes;
+		_textures.emplace_back(entry.id);
+		entries.emplace(paths[i], entry);
 	}
-	// Resize the indirect commands vector and the object data vector.
-	_cmds.resize(maxBatches);
-	_objectData.resize(maxBatches);
-	// Allocate GL buffers
-	// This is the Vertex Array Object, it specifies how the vertex data should be read by the GPU
-	glCreateVertexArrays(1, &_vao);
-	// This is the Vertex Buffer Object, it holds on all the mesh vertex data in this model
-	glCreateBuffers(1, &_vbo);
-	// This is the Element Buffer Object (I call it the Index Buffer Object, same thing)
-	// it holds all the indices for all the meshes
-	glCreateBuffers(1, &_ibo);
-	// This is the transform data buffer, it holds the local transform for each mesh
-	glCreateBuffers(1, &_transformData);
-	// Create the object data buffers, they are useful when drawing because they associate all the
-	// necessary indices (transform index, base color index, ...) to a mesh, allowing the shader
-	// to fetch the information from the other buffers, keep in mind this is per batch.
-	glCreateBuffers(_objectData.size(), _objectData.data());
-	// Finally this is the indirect data buffer, it holds all the information required for OpenGL to draw the mesh,
-	// this is also per batch.
-	glGenBuffers(_cmds.size(), _cmds.data());
-
-	// First, we need to figure out how big our vertex and index buffer should be
-	size_t vertexSize = 0;
-	size_t indexSize = 0;
-	for (const auto &info : meshCreateInfos) {
-		vertexSize += info.vertices.size() * sizeof(Vertex);
-		indexSize += info.indices.size() * sizeof(uint32_t);
+	// Textures the model doesn't use anymore
+	for (const auto &[path, entry] : _textureEntries) {
+		if (!entries.contains(path)) {
+			_streamer.Release(entry.id);
+		}
 	}
+	_textureEntries = std::move(entries);
+
+	_stats.textureLoadMilliseconds =
+		std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - loadStart)
+			.count();
+	loadTimer.Record(_stats.textureLoadMilliseconds);
+	spdlog::info(
+		"Model: Loaded {} textures ({} unchanged, {} cache hits) in {:.2f} ms, {:.2f} MiB -> {:.2f} MiB, encoded {:.2f} Mpixels in {:.2f} ms",
+		_lastReload.texturesLoaded, _lastReload.texturesReused,
+		_stats.textureCacheHits, _stats.textureLoadMilliseconds,
+		_stats.uncompressedTextureBytes / (1024.0 * 1024.0),
+		_stats.textureBytes / (1024.0 * 1024.0),
+		_stats.encodedTexels / 1e6, _stats.encodeMilliseconds);
+}
 
-	// Allocate the storage
-	glNamedBufferStorage(_vbo, vertexSize, nullptr, GL_DYNAMIC_STORAGE_BIT);
-	glNamedBufferStorage(_ibo, indexSize, nullptr, GL_DYNAMIC_STORAGE_BIT);
-
-	// Associate the vertex array object, with our vertex and index buffer
-	glVertexArrayVertexBuffer(_vao, 0, _vbo, 0, sizeof(Vertex));
-	glVertexArrayElementBuffer(_vao, _ibo);
-
-	// Tell OpenGL which vertex location index we want to use
-	// it maps to the "layout (location = N) in vecN position/normal/..." in our vertex shader
-	glEnableVertexArrayAttrib(_vao, 0);
-	glEnableVertexArrayAttrib(_vao, 1);
-	glEnableVertexArrayAttrib(_vao, 2);
-	glEnableVertexArrayAttrib(_vao, 3);
-
-	// Tell OpenGL how to interpret each vertex attribute
-	//                              location          components  type      transpose  offset
-	glVertexArrayAttribFormat(_vao, /*location = */ 0, /*vec*/ 3, GL_FLOAT,
-				  GL_FALSE, offsetof(Vertex, position));
-	glVertexArrayAttribFormat(_vao, /*location = */ 1, /*vec*/ 3, GL_FLOAT,
-				  GL_FALSE, offsetof(Vertex, normal));
-	glVertexArrayAttribFormat(_vao, /*location = */ 2, /*vec*/ 2, GL_FLOAT,
-				  GL_FALSE, offsetof(Vertex, uv));
-	glVertexArrayAttribFormat(_vao, /*location = */ 3, /*vec*/ 4, GL_FLOAT,
-				  GL_FALSE, offsetof(Vertex, tangent));
-
-	// Finally, bind each vertex attribute to a vertex buffer,
-	// the 0th buffer, which is the only one we bound
-	glVertexArrayAttribBinding(_vao, 0, 0);
-	glVertexArrayAttribBinding(_vao, 1, 0);
-	glVertexArrayAttribBinding(_vao, 2, 0);
-	glVertexArrayAttribBinding(_vao, 3, 0);
+Model::Model(std::string_view file, GeometryPool &pool,
+	     TextureStreamer &streamer, const ModelLoadOptions &options)
+	: _pool(pool)
+	, _streamer(streamer)
+	, _path(file)
+	, _options(options)
+{
+	ZoneScoped;
+	ZoneText(file.data(), file.size());
+	Import();
+	_stats.loadMilliseconds = _lastReload.milliseconds;
+	spdlog::info(
+		"Model: Loaded {} ({} meshes, {} vertex bytes, {} index bytes, {} texture bytes) in {:.2f} ms",
+		file, _meshes.size(), _stats.vertexBytes, _stats.indexBytes,
+		_stats.textureBytes, _stats.loadMilliseconds);
+}
 
-	// For each mesh
-	for (auto &info : meshCreateInfos) {
-		// Upload at a given vertex and index offset the data
-		glNamedBufferSubData(_vbo, info.vertexOffset,
-				     info.vertices.size() * sizeof(Vertex),
-				     info.vertices.data());
-		glNamedBufferSubData(_ibo, info.indexOffset,
-				     info.indices.size() * sizeof(uint32_t),
-				     info.indices.data());
-		_meshes.emplace_back(info);
+bool Model::Reload()
+{
+	ZoneScoped;
+	ZoneText(_path.c_str(), _path.size());
+	if (!Import()) {
+		return false;
 	}
+	spdlog::info(
+		"Model: Reloaded {} in {:.2f} ms, {} meshes uploaded ({} unchanged), {} textures loaded ({} unchanged)",
+		_path, _lastReload.milliseconds, _lastReload.meshesUploaded,
+		_lastReload.meshesReused, _lastReload.texturesLoaded,
+		_lastReload.texturesReused);
+	return true;
 }
 
-Model::~Model() = default;
+bool Model::Import()
+{
+	ZoneScoped;
+	static const MetricTimer loadTimer("model.load");
+	static const MetricTimer optimizeTimer("model.optimize");
+	static const MetricTimer uploadTimer("model.upload");
+	static const MetricCounter uploadCounter("gpu.uploaded_bytes", "bytes");
+	const auto importStart = std::chrono::steady_clock::now();
+	ModelImportData data;
+	if (!ImportModel(_path, data)) {
+		// Keep what we have, a half written file shouldn't make the model disappear
+		return false;
+	}
+	_lastReload = {};
+	// Dependencies are compared canonically, the watcher and glTF files may spell paths differently
+	_dependencies.clear();
+	for (const auto &dependency : data.dependencies) {
+		_dependencies.emplace_back(CanonicalPath(dependency));
+	}
+	LoadTextures(data.texturePaths);
+
+	// The vertex layout and index size are dictated by the pool we share with other models
+	const auto vertexFormat = _options.vertexFormat;
+	const uint32_t vertexStride = _pool.VertexStride();
+	const uint32_t indexSize = _pool.IndexSize();
+	std::erase_if(data.meshes, [](const MeshCreateInfo &info) {
+		return info.indices.empty();
+	});
+	// Indices are relative to each mesh's base vertex, so 16 bits are enough as long as no
+	// single mesh has more than 65536 vertices. Larger meshes are split into meshes that fit.
+	if (indexSize == sizeof(uint16_t)) {
+		std::vector<MeshCreateInfo> meshes;
+		for (auto &info : data.meshes) {
+			if (info.vertices.size() <= MAX_SHORT_INDEX_VERTICES) {
+				meshes.emplace_back(std::move(info));
+				continue;
+			}
+			auto parts = SplitMesh(info, MAX_SHORT_INDEX_VERTICES);
+			spdlog::info(
+				"Model: Split a mesh of {} with {} vertices in {} for 16-bit indices",
+				_path, info.vertices.size(), parts.size());
+			std::move(parts.begin(), parts.end(),
+				  std::back_inserter(meshes));
+		}
+		data.meshes = std::move(meshes);
+	}
+
+	// Hash the imported data, meshes we already have with the same content are kept as they are
+	std::vector<uint64_t> hashes(data.meshes.size());
+	ParallelFor(data.meshes.size(), [&](size_t i) {
+		ZoneScopedN("Model: Hash mesh");
+		const auto &info = data.meshes[i];
+		hashes[i] = HashCombine(
+			HashBytes(info.vertices.data(),
+				  info.vertices.size() * sizeof(Vertex)),
+			HashBytes(info.indices.data(),
+				  info.indices.size() * sizeof(uint32_t)));
+	});
+	// A model can use the same mesh several times, each copy is matched once
+	std::unordered_multimap<uint64_t, size_t> currentMeshes;
+	for (size_t i = 0; i < _meshEntries.size(); ++i) {
+		currentMeshes.emplace(_meshEntries[i].hash, i);
+	}
+	std::vector<Mesh> meshes;
+	std::vector<MeshEntry> meshEntries;
+	std::vector<size_t> changed;
+	for (size_t i = 0; i < data.meshes.size(); ++i) {
+		const auto current = currentMeshes.find(hashes[i]);
+		if (current == currentMeshes.end()) {
+			changed.emplace_back(i);
+			continue;
+		}
+		// Same geometry, only the transform and texture may have moved
+		auto &mesh = meshes.emplace_back(_meshes[current->second]);
+		mesh.SetTransformIndex(data.meshes[i].transformIndex);
+		mesh.SetBaseColorTexture(data.meshes[i].baseColorTexture);
+		meshEntries.emplace_back(
+			std::move(_meshEntries[current->second]));
+		currentMeshes.erase(current);
+	}
+	// Give the ranges of the meshes that are gone back to the pool
+	for (const auto &[hash, index] : currentMeshes) {
+		_pool.FreeIndices(_meshEntries[index].indices);
+		_pool.FreeVertices(_meshEntries[index].vertices);
+	}
+	_lastReload.meshesReused = meshes.size();
+	_lastReload.meshesUploaded = changed.size();
+
+	// Optimize every new mesh for the GPU, meshes are independent so this runs in parallel
+	const auto &optimization = _options.optimization;
+	const auto &lodOptions = _options.lods;
+	const auto firstNew = meshEntries.size();
+	meshEntries.resize(firstNew + changed.size());
+	const auto optimizeStart = std::chrono::steady_clock::now();
+	ParallelFor(changed.size(), [&](size_t i) {
+		ZoneScopedN("Model: Optimize mesh");
+		auto &info = data.meshes[changed[i]];
+		auto &entry = meshEntries[firstNew + i];
+		entry.hash = hashes[changed[i]];
+		if (optimization.optimize || optimization.buildMeshlets) {
+			entry.cache = OptimizeMesh(info.vertices, info.indices,
+						   entry.meshlets, optimization);
+		}
+		// Levels of detail are built last, so they share the optimized vertex order
+		if (lodOptions.maxLods > 1) {
+			ZoneScopedN("Model: Build LODs");
+			info.lods = BuildLods(info.vertices, info.indices,
+					      lodOptions);
+		}
+	});
+	const auto optimizeMilliseconds =
+		std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - optimizeStart)
+			.count();
+	if (!changed.empty()) {
+		optimizeTimer.Record(optimizeMilliseconds);
+		MeshCacheStats cache;
+		size_t meshletCount = 0;
+		size_t lodCount = 0;
+		for (size_t i = 0; i < changed.size(); ++i) {
+			cache += meshEntries[firstNew + i].cache;
+			meshletCount +=
+				meshEntries[firstNew + i].meshlets.meshlets.size();
+			lodCount += data.meshes[changed[i]].lods.size();
+		}
+		spdlog::info(
+			"Model: Optimized {} meshes in {:.2f} ms, ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}, {} meshlets, {} LODs",
+			changed.size(), optimizeMilliseconds, cache.AcmrBefore(), cache.AcmrAfter(), cache.AtvrBefore(),
+			cache.AtvrAfter(), meshletCount, lodCount);
+	}
 
-void Model::Draw(const Shader &shader) const
+	// Scratch space for the data that needs converting before the upload
+	std::vector<CompactVertex> compactVertices;
+	std::vector<uint16_t> shortIndices;
+	std::vector<uint32_t> indices;
+	const auto uploadStart = std::chrono::steady_clock::now();
+	size_t uploadedBytes = 0;
+	// For each new mesh
+	for (size_t i = 0; i < changed.size(); ++i) {
+		ZoneScopedN("Model: Upload mesh");
+		auto &info = data.meshes[changed[i]];
+		auto &entry = meshEntries[firstNew + i];
+		// Gather the index buffers of every level of detail, they follow the mesh indices
+		indices = info.indices;
+		for (const auto &lod : info.lods) {
+			indices.insert(indices.end(), lod.indices.begin(),
+				       lod.indices.end());
+		}
+		// Every mesh has its own ranges in the pool, so it can be replaced on its own
+		entry.vertices = _pool.AllocateVertices(info.vertices.size());
+		entry.indices = _pool.AllocateIndices(indices.size());
+		info.vertexFormat = vertexFormat;
+		info.vertexStride = vertexStride;
+		info.indexSize = indexSize;
+		info.vertexOffset = (size_t)entry.vertices.offset * vertexStride;
+		info.indexOffset = (size_t)entry.indices.offset * indexSize;
+		info.meshletCount = entry.meshlets.meshlets.size();
+
+		// Upload the data at the start of our ranges
+		if (vertexFormat == VertexFormat::Compact) {
+			compactVertices.clear();
+			for (const auto &vertex : info.vertices) {
+				compactVertices.emplace_back(PackVertex(
+					vertex, info.boundsMin,
+					info.boundsMax));
+			}
+			_pool.UploadVertices(entry.vertices, 0,
+					     compactVertices.data(),
+					     compactVertices.size() *
+						     sizeof(CompactVertex));
+			uploadedBytes +=
+				compactVertices.size() * sizeof(CompactVertex);
+		} else {
+			_pool.UploadVertices(entry.vertices, 0,
+					     info.vertices.data(),
+					     info.vertices.size() *
+						     sizeof(Vertex));
+			uploadedBytes += info.vertices.size() * sizeof(Vertex);
+		}
+		if (indexSize == sizeof(uint16_t)) {
+			shortIndices.assign(indices.begin(), indices.end());
+			_pool.UploadIndices(entry.indices, 0,
+					    shortIndices.data(),
+					    shortIndices.size() *
+						    sizeof(uint16_t));
+		} else {
+			_pool.UploadIndices(entry.indices, 0, indices.data(),
+					    indices.size() * sizeof(uint32_t));
+		}
+		uploadedBytes += indices.size() * indexSize;
+		meshes.emplace_back(info);
+	}
+	if (!changed.empty()) {
+		uploadTimer.Record(std::chrono::duration<double, std::milli>(
+					   std::chrono::steady_clock::now() -
+					   uploadStart)
+					   .count());
+		uploadCounter.Add(uploadedBytes);
+	}
+	_meshes = std::move(meshes);
+	_meshEntries = std::move(meshEntries);
+	// The scene uploads our transforms again when it sees a new generation
+	static std::atomic<uint64_t> transformGenerations = 0;
+	_transforms = std::move(data.transforms);
+	_animations = std::move(data.animations);
+	_transformGeneration = ++transformGenerations;
+	_animationSeconds = std::numeric_limits<double>::quiet_NaN();
+
+	// Totals over every mesh, kept or new
+	_stats.vertexBytes = 0;
+	_stats.indexBytes = 0;
+	_stats.cache = {};
+	_stats.lodCount = 0;
+	_stats.meshletCount = 0;
+	for (size_t i = 0; i < _meshes.size(); ++i) {
+		const auto &entry = _meshEntries[i];
+		_stats.vertexBytes += (size_t)entry.vertices.size * vertexStride;
+		_stats.indexBytes += (size_t)entry.indices.size * indexSize;
+		_stats.cache += entry.cache;
+		_stats.lodCount += _meshes[i].LodCount() - 1;
+		_stats.meshletCount += entry.meshlets.meshlets.size();
+	}
+	_stats.nodeCount = _transforms.Size();
+	_stats.animationCount = _animations.size();
+	_lastReload.milliseconds =
+		std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - importStart)
+			.count();
+	loadTimer.Record(_lastReload.milliseconds);
+	return true;
+}
+
+Model::~Model()
 {
-	// Define an object data structure (this should match with the one in the shader)
-	struct ObjectData {
-		uint32_t transformIndex;
-		uint32_t baseColorIndex;
-		uint32_t normalIndex;
-	};
-	struct BatchData {
-		std::vector<ObjectData> objects;
-		std::vector<MeshIndirectInfo> commands;
-	};
-	std::vector<BatchData> objectBatches(_cmds.size());
-	std::vector<std::set<uint32_t> > textureHandles(_cmds.size());
-	// For each mesh
-	for (const auto &mesh : _meshes) {
-		// Calculate the batch index this mesh belongs to (just divide by the "batch size")
-		const auto index = mesh.BaseColorTexture() / 16;
-		// Get the mesh indirect info structure
-		objectBatches[index].commands.emplace_back(mesh.Info());
-		// Get the mesh general information
-		objectBatches[index].objects.emplace_back(ObjectData{
-			// Restrict the texture range to [0, 15], because by batching texture
-			// indices must not be "global", but local to the batch group
-			mesh.TransformIndex(), mesh.BaseColorTexture() % 16,
-			// Exercise: Can you do the same for normal textures?
-			mesh.NormalTexture() });
-		// Insert the texture index for this batch in a set, this is useful
-		// when binding the textures because we will need unique handles
-		textureHandles[index].insert(
-			_textures[mesh.BaseColorTexture()]);
+	// Give our ranges back to the pool, other models can reuse them
+	for (const auto &entry : _meshEntries) {
+		_pool.FreeIndices(entry.indices);
+		_pool.FreeVertices(entry.vertices);
 	}
+	for (const auto &[path, entry] : _textureEntries) {
+		_streamer.Release(entry.id);
+	}
+}
+
+bool Model::DependsOn(const fs::path &path) const
+{
+	const auto canonical = CanonicalPath(path);
+	return std::find(_dependencies.begin(), _dependencies.end(),
+			 canonical) != _dependencies.end();
+}
+
+const ModelStats &Model::Stats() const
+{
+	return _stats;
+}
+
+const ModelReloadStats &Model::LastReload() const
+{
+	return _lastReload;
+}
+
+const MeshletData &Model::Meshlets(size_t mesh) const
+{
+	return _meshEntries[mesh].meshlets;
+}
+
+const std::vector<Animation> &Model::Animations() const
+{
+	return _animations;
+}
+
+const std::string &Model::Path() const
+{
+	return _path;
+}
+
+// How big a mesh appears on screen
+struct ScreenExtent {
+	// Largest axis scale of the mesh's transform
+	float scale;
+	// Number of pixels per world unit at the closest point of the mesh
+	float pixelsPerUnit;
+};
+
+static ScreenExtent ProjectMesh(const Mesh &mesh, const glm::mat4 &transform,
+				const glm::vec3 &cameraPosition,
+				const ModelDrawView &view)
+{
+	// Errors and bounds are in object space, scale them conservatively by the largest axis scale
+	const auto scale = std::max(
+		{ glm::length(glm::vec3(transform[0])),
+		  glm::length(glm::vec3(transform[1])),
+		  glm::length(glm::vec3(transform[2])) });
+	const auto center =
+		glm::vec3(transform * glm::vec4(mesh.BoundsCenter(), 1.0f));
+	// Use the closest point of the bounding sphere, the mesh may span a big depth range
+	const auto distance = std::max(
+		glm::distance(center, cameraPosition) -
+			mesh.BoundsRadius() * scale,
+		NEAR_DISTANCE);
+	// projection[1][1] is cot(fov / 2), so this is the number of pixels per world unit at `distance`
+	return { scale, view.projection[1][1] * view.viewportHeight * 0.5f /
+				distance };
+}
 
-	// Copy the transform data we just created to the GPU
-	glNamedBufferData(_transformData,
-			  _transforms.size() * sizeof(glm::mat4),
-			  _transforms.data(), GL_DYNAMIC_DRAW);
-	// Bind the buffer to the storage buffer, location = 1
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, _transformData);
-
-	// Bind the shader because we will be setting uniforms now
-	shader.Bind();
-	// For each batch
-	for (uint32_t index = 0; const auto &batch : objectBatches) {
-		// Write the object data to the current object uniform buffer
-		glNamedBufferData(_objectData[index],
-				  batch.objects.size() * sizeof(ObjectData),
-				  batch.objects.data(), GL_DYNAMIC_DRAW);
-		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0,
-				 _objectData[index]);
-
-		// Write the indirect commands to the current indirect buffer
-		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _cmds[index]);
-		glNamedBufferData(_cmds[index],
-				  batch.commands.size() *
-					  sizeof(MeshIndirectInfo),
-				  batch.commands.data(), GL_DYNAMIC_DRAW);
-
-		// Set all the active textures for this batch
-		for (uint32_t offset = 0;
-		     const auto texture : textureHandles[index]) {
-			shader.Set(2 + offset, offset);
-			glActiveTexture(GL_TEXTURE0 + offset);
-			glBindTexture(GL_TEXTURE_2D, texture);
-			offset++;
+// Picks the coarsest level of detail whose error stays under the threshold once projected on screen
+static uint32_t SelectLod(const Mesh &mesh, const ScreenExtent &extent,
+			  const ModelDrawView &view)
+{
+	if (view.lodErrorThreshold <= 0.0f || mesh.LodCount() == 1) {
+		return 0;
+	}
+	uint32_t lod = 0;
+	for (uint32_t i = 1; i < mesh.LodCount(); ++i) {
+		if (mesh.Lod(i).error * extent.scale * extent.pixelsPerUnit >
+		    view.lodErrorThreshold) {
+			break;
 		}
+		lod = i;
+	}
+	return lod;
+}
 
-		// Finally, bind the VAO and issue the draw call
-		glBindVertexArray(_vao);
-		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
-					    nullptr, batch.commands.size(),
-					    sizeof(MeshIndirectInfo));
-		// Increment the index to go to the next batch
-		index++;
+// Picks the texture level with about one texel per pixel, assuming the texture is stretched once
+// over the mesh's bounding sphere. Meshes tiling their textures get a level too coarse.
+static uint32_t SelectMip(const Mesh &mesh, const ScreenExtent &extent,
+			  uint32_t textureSize)
+{
+	const auto pixels =
+		2.0f * mesh.BoundsRadius() * extent.scale * extent.pixelsPerUnit;
+	if (pixels >= textureSize) {
+		return 0;
+	}
+	return (uint32_t)std::floor(
+		std::log2(textureSize / std::max(pixels, 1.0f)));
+}
+
+void Model::Animate(double seconds)
+{
+	ZoneScoped;
+	// Sampling at the same time again would flag every animated node for nothing
+	if (!_animations.empty() && seconds != _animationSeconds) {
+		SampleAnimation(_animations[0], seconds, _transforms);
+		_animationSeconds = seconds;
+	}
+	// Does nothing when no node moved, but the dirty ranges of the last frame are cleared
+	_transforms.Update();
+}
+
+void Model::AppendDraws(DrawList &drawList, const ModelDrawView &view) const
+{
+	ZoneScoped;
+	// Our transform indices are local to the model, they start where our block lands in the buffer
+	const auto firstTransform = drawList.transformCount;
+	drawList.transformBlocks.emplace_back(TransformBlock{
+		&_transforms, firstTransform, _transformGeneration });
+	drawList.transformCount += _transforms.Size();
+	const auto &worlds = _transforms.WorldMatrices();
+	const auto cameraPosition = glm::vec3(glm::inverse(view.view)[3]);
+	// For each mesh
+	for (const auto &mesh : _meshes) {
+		// Get the mesh indirect info structure, for the level of detail we need
+		const auto extent =
+			ProjectMesh(mesh, worlds[mesh.TransformIndex()],
+				    cameraPosition, view);
+		drawList.commands.emplace_back(
+			mesh.Info(SelectLod(mesh, extent, view)));
+		// Get the mesh general information, the texture slot is assigned by the scene
+		// once it knows which textures are drawn together
+		drawList.objects.emplace_back(ObjectData{
+			firstTransform + mesh.TransformIndex(), 0,
+			// Exercise: Can you do the same for normal textures?
+			mesh.NormalTexture(), mesh.Format(),
+			glm::vec4(mesh.PositionOffset(), 0.0f),
+			glm::vec4(mesh.PositionScale(), 0.0f) });
+		// Tell the streamer which level we need, it is resident a few frames later at best
+		const auto texture = _textures[mesh.BaseColorTexture()];
+		drawList.textureRequests.emplace_back(TextureRequest{
+			texture,
+			SelectMip(mesh, extent, _streamer.Size(texture)) });
+		drawList.baseColorTextures.emplace_back(texture);
 	}
 }
\ No newline at end of file
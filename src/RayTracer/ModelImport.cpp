@@ -0,0 +1,451 @@
+#include <RayTracer/ModelImport.h>
+
+#include <RayTracerLib/Metrics.hpp>
+
+#include <cgltf.h>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <spdlog/spdlog.h>
+#include <tracy/Tracy.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+// Helper function to find the actual texture path given a CGLTF image.
+static std::string FindTexturePath(const fs::path &basePath,
+				   const cgltf_image *image)
+{
+	std::string texturePath;
+	if (!image->uri) {
+		auto newPath = basePath / image->name;
+		if (!newPath.has_extension()) {
+			if (std::strcmp(image->mime_type, "image/png") == 0) {
+				newPath.replace_extension("png");
+			} else if (std::strcmp(image->mime_type, "image/jpg") ==
+				   0) {
+				newPath.replace_extension("jpg");
+			}
+		}
+		texturePath = newPath.generic_string();
+	} else {
+		texturePath = (basePath / image->uri).generic_string();
+	}
+	return texturePath;
+}
+
+// The node's local transform as translation, rotation and scale, the way we animate it
+static uint32_t AddNode(TransformHierarchy &hierarchy, const cgltf_node &node,
+			uint32_t parent)
+{
+	glm::vec3 translation(0.0f);
+	glm::quat rotation(1.0f, 0.0f, 0.0f, 0.0f);
+	glm::vec3 scale(1.0f);
+	if (node.has_matrix) {
+		// glTF only allows matrices that decompose like this, and doesn't animate them
+		const auto matrix = glm::make_mat4(node.matrix);
+		translation = glm::vec3(matrix[3]);
+		scale = glm::vec3(glm::length(glm::vec3(matrix[0])),
+				  glm::length(glm::vec3(matrix[1])),
+				  glm::length(glm::vec3(matrix[2])));
+		// A mirrored matrix flips one of the axes
+		if (glm::determinant(glm::mat3(matrix)) < 0.0f) {
+			scale.x = -scale.x;
+		}
+		if (scale.x != 0.0f && scale.y != 0.0f && scale.z != 0.0f) {
+			rotation = glm::quat_cast(glm::mat3(
+				glm::vec3(matrix[0]) / scale.x,
+				glm::vec3(matrix[1]) / scale.y,
+				glm::vec3(matrix[2]) / scale.z));
+		}
+	}
+	if (node.has_translation) {
+		translation = glm::make_vec3(node.translation);
+	}
+	if (node.has_rotation) {
+		// glTF stores x, y, z, w and glm takes w first
+		rotation = glm::quat(node.rotation[3], node.rotation[0],
+				     node.rotation[1], node.rotation[2]);
+	}
+	if (node.has_scale) {
+		scale = glm::make_vec3(node.scale);
+	}
+	return hierarchy.Add(parent, translation, rotation, scale);
+}
+
+static void ImportAnimations(
+	const cgltf_data &model,
+	const std::unordered_map<const cgltf_node *, uint32_t> &nodes,
+	std::vector<Animation> &animations)
+{
+	for (uint32_t i = 0; i < model.animations_count; ++i) {
+		const auto &source = model.animations[i];
+		auto &animation = animations.emplace_back();
+		animation.name = source.name ? source.name : "";
+		for (uint32_t j = 0; j < source.channels_count; ++j) {
+			const auto &channel = source.channels[j];
+			const auto node = nodes.find(channel.target_node);
+			if (node == nodes.end()) {
+				continue;
+			}
+			AnimationChannel result;
+			result.node = node->second;
+			switch (channel.target_path) {
+			case cgltf_animation_path_type_translation:
+				result.path = AnimationPath::Translation;
+				break;
+			case cgltf_animation_path_type_rotation:
+				result.path = AnimationPath::Rotation;
+				break;
+			case cgltf_animation_path_type_scale:
+				result.path = AnimationPath::Scale;
+				break;
+			default:
+				// Morph target weights, we have no morph targets
+				continue;
+			}
+			const auto &sampler = *channel.sampler;
+			switch (sampler.interpolation) {
+			case cgltf_interpolation_type_step:
+				result.interpolation = AnimationInterpolation::Step;
+				break;
+			case cgltf_interpolation_type_cubic_spline:
+				result.interpolation =
+					AnimationInterpolation::CubicSpline;
+				break;
+			default:
+				result.interpolation =
+					AnimationInterpolation::Linear;
+				break;
+			}
+
+			// Unpacking also converts the normalized integers rotations may be stored as
+			const size_t width =
+				result.path == AnimationPath::Rotation ? 4 : 3;
+			const size_t keysPerTime =
+				result.interpolation ==
+						AnimationInterpolation::CubicSpline ?
+					3 :
+					1;
+			result.times.resize(sampler.input->count);
+			cgltf_accessor_unpack_floats(sampler.input,
+						     result.times.data(),
+						     result.times.size());
+			if (result.times.empty() ||
+			    sampler.output->count !=
+				    result.times.size() * keysPerTime) {
+				spdlog::warn(
+					"ModelImport: Skipping a channel of animation {} with {} keys for {} times",
+					i, sampler.output->count,
+					result.times.size());
+				continue;
+			}
+			result.values.resize(sampler.output->count * width);
+			cgltf_accessor_unpack_floats(sampler.output,
+						     result.values.data(),
+						     result.values.size());
+			animation.duration =
+				std::max(animation.duration, result.times.back());
+			animation.channels.emplace_back(std::move(result));
+		}
+	}
+}
+
+bool ImportModel(std::string_view file, ModelImportData &data)
+{
+	ZoneScoped;
+	ZoneText(file.data(), file.size());
+	static const MetricTimer parseTimer("model.parse");
+	const MetricScope scope(parseTimer);
+	data = {};
+	cgltf_options options = {};
+	cgltf_data *model = nullptr;
+	// Read GLTF, no additional options are required
+	if (cgltf_parse_file(&options, file.data(), &model) !=
+	    cgltf_result_success) {
+		spdlog::error("ModelImport: Unable to parse {}", file);
+		return false;
+	}
+	// Load all GLTF buffers
+	if (cgltf_load_buffers(&options, model, file.data()) !=
+	    cgltf_result_success) {
+		spdlog::error("ModelImport: Unable to load the buffers of {}",
+			      file);
+		cgltf_free(model);
+		return false;
+	}
+
+	// Get the base path (useful when loading textures)
+	fs::path path(file.data());
+	const auto basePath = path.parent_path();
+	// The model depends on its buffers as well, they can live in separate files
+	data.dependencies.emplace_back(file);
+	for (uint32_t i = 0; i < model->buffers_count; ++i) {
+		const auto *uri = model->buffers[i].uri;
+		if (uri && std::strncmp(uri, "data:", 5) != 0) {
+			data.dependencies.emplace_back(
+				(basePath / uri).generic_string());
+		}
+	}
+	// This is our texture cache, to make sure we don't load the same texture twice
+	std::unordered_map<std::string, size_t> textureIds;
+	for (uint32_t i = 0; i < model->materials_count;
+	     ++i) // For each material
+	{
+		const auto &material = model->materials[i];
+		// Get the material's base color texture
+		const auto *image = material.pbr_metallic_roughness
+					    .base_color_texture.texture->image;
+		// Find its texture path
+		const auto texturePath = FindTexturePath(basePath, image);
+		if (textureIds.contains(texturePath)) {
+			// If we already found the texture, go onto the next material
+			continue;
+		}
+		// Register this texture index in our cache, the textures themselves are loaded by the caller
+		textureIds[texturePath] = data.texturePaths.size();
+		data.texturePaths.emplace_back(texturePath);
+		data.dependencies.emplace_back(texturePath);
+	}
+
+	// Walk the scene depth first, so every subtree is a contiguous range of the hierarchy.
+	// The stack holds the nodes to visit with the index of their parent.
+	std::unordered_map<const cgltf_node *, uint32_t> nodeIndices;
+	std::vector<std::pair<const cgltf_node *, uint32_t> > stack;
+	for (auto i = model->scene->nodes_count; i-- > 0;) {
+		stack.emplace_back(model->scene->nodes[i],
+				   TransformHierarchy::NO_PARENT);
+	}
+	while (!stack.empty()) {
+		const auto [node, parent] = stack.back();
+		stack.pop_back();
+		const auto transformIndex =
+			AddNode(data.transforms, *node, parent);
+		nodeIndices[node] = transformIndex;
+		// Pushed backwards, so the first child is visited next
+		for (auto j = node->children_count; j-- > 0;) {
+			stack.emplace_back(node->children[j], transformIndex);
+		}
+		// Nodes without meshes still move their children
+		if (!node->mesh) {
+			continue;
+		}
+		// For each primitive in the node
+		for (uint32_t j = 0; j < node->mesh->primitives_count;
+		     ++j) {
+			const auto &primitive =
+				node->mesh->primitives[j];
+			const glm::vec3 *positionPtr = nullptr;
+			const glm::vec3 *normalPtr = nullptr;
+			const glm::vec2 *uvPtr = nullptr;
+			const glm::vec4 *tangentPtr = nullptr;
+			uint64_t vertexCount = 0;
+			// Get its vertex data
+			for (uint32_t k = 0;
+			     k < primitive.attributes_count; ++k) {
+				// Get the attribute information (position, normal, ...)
+				const auto &attribute =
+					primitive.attributes[k];
+				const auto *accessor = attribute.data;
+				// Get the buffer view associated with this attribute
+				const auto *view =
+					accessor->buffer_view;
+				const auto *dataPtr =
+					(const char *)view->buffer->data;
+				// If this is confusing you can refer to the glTF main scheme by Khronos, it should clear up some things
+				switch (attribute.type) {
+				case cgltf_attribute_type_position:
+					vertexCount = accessor->count;
+					// Set the `positionPtr`
+					positionPtr =
+						(const glm::vec3
+							 *)(dataPtr +
+							    view->offset +
+							    accessor->offset);
+					break;
+
+				case cgltf_attribute_type_normal:
+					// Set the `normalPtr`
+					normalPtr =
+						(const glm::vec3
+							 *)(dataPtr +
+							    view->offset +
+							    accessor->offset);
+					break;
+
+				case cgltf_attribute_type_texcoord:
+					// Set the `uvPtr`
+					uvPtr = (const glm::vec2
+							 *)(dataPtr +
+							    view->offset +
+							    accessor->offset);
+					break;
+
+				case cgltf_attribute_type_tangent:
+					// Set the `tangentPtr`
+					tangentPtr =
+						(const glm::vec4
+							 *)(dataPtr +
+							    view->offset +
+							    accessor->offset);
+					break;
+
+				default:
+					break;
+				}
+			}
+			// Reserve space for the vertices in our own vertex format
+			std::vector<Vertex> vertices;
+			vertices.resize(vertexCount);
+			// Object space bounds, the compact format quantizes positions relative to them
+			glm::vec3 boundsMin(0.0f);
+			glm::vec3 boundsMax(0.0f);
+			{
+				// Get the pointer to the base of the vector
+				auto *ptr = vertices.data();
+				// For each vertex
+				for (uint32_t v = 0; v < vertexCount;
+				     ++v, ++ptr) {
+					// Copy the attribute (if available) to the current pointer (will increment every iteration)
+					if (positionPtr) {
+						std::memcpy(
+							&ptr->position,
+							positionPtr + v,
+							sizeof(glm::vec3));
+					}
+					if (normalPtr) {
+						std::memcpy(
+							&ptr->normal,
+							normalPtr + v,
+							sizeof(glm::vec3));
+					}
+					if (uvPtr) {
+						std::memcpy(
+							&ptr->uv,
+							uvPtr + v,
+							sizeof(glm::vec2));
+					}
+					if (tangentPtr) {
+						std::memcpy(
+							&ptr->tangent,
+							tangentPtr + v,
+							sizeof(glm::vec4));
+					}
+					if (v == 0) {
+						boundsMin = ptr->position;
+						boundsMax = ptr->position;
+					}
+					boundsMin = glm::min(boundsMin,
+							     ptr->position);
+					boundsMax = glm::max(boundsMax,
+							     ptr->position);
+				}
+			}
+
+			std::vector<uint32_t> indices;
+			{
+				// Get the indices information for the primitive
+				const auto *accessor =
+					primitive.indices;
+				const auto *view =
+					accessor->buffer_view;
+				const char *dataPtr =
+					(const char *)view->buffer->data;
+				// Reserve space for our indices buffer
+				indices.reserve(accessor->count);
+				// Check the index type (uint8, uint16 or uin32)
+				switch (accessor->component_type) {
+				// Copy the whole index buffer to our vector
+				case cgltf_component_type_r_8:
+				case cgltf_component_type_r_8u: {
+					const auto *ptr =
+						(const uint8_t
+							 *)(dataPtr +
+							    view->offset +
+							    accessor->offset);
+					std::copy(ptr,
+						  ptr + accessor->count,
+						  std::back_inserter(
+							  indices));
+				} break;
+
+				case cgltf_component_type_r_16:
+				case cgltf_component_type_r_16u: {
+					const auto *ptr =
+						(const uint16_t
+							 *)(dataPtr +
+							    view->offset +
+							    accessor->offset);
+					std::copy(ptr,
+						  ptr + accessor->count,
+						  std::back_inserter(
+							  indices));
+				} break;
+
+				case cgltf_component_type_r_32f:
+				case cgltf_component_type_r_32u: {
+					const auto *ptr =
+						(const uint32_t
+							 *)(dataPtr +
+							    view->offset +
+							    accessor->offset);
+					std::copy(ptr,
+						  ptr + accessor->count,
+						  std::back_inserter(
+							  indices));
+				} break;
+
+				default:
+					break;
+				}
+			}
+			// Get the primitive's material base color texture path
+			const auto baseColorURI = FindTexturePath(
+				basePath,
+				primitive.material
+					->pbr_metallic_roughness
+					.base_color_texture.texture
+					->image);
+			// Emplace a `MeshCreateInfo` (we will use this later)
+			data.meshes.emplace_back(MeshCreateInfo{
+				std::move(vertices),
+				std::move(indices),
+				transformIndex,
+				// Exercise: this doesn't handle missing textures, it's possible that a mesh may not have any color
+				// texture, can you change this behavior and display a default texture of your choice when this happens?
+				(uint32_t)textureIds[baseColorURI],
+				// Exercise: We don't load normal textures, can you load the normal textures (when available)
+				// and apply some basic normal mapping?
+				0,
+				// The buffer layout is only known once every mesh is loaded
+				0,
+				0,
+				boundsMin,
+				boundsMax,
+			});
+		}
+	}
+	data.transforms.Build();
+	data.transforms.Update();
+	ImportAnimations(*model, nodeIndices, data.animations);
+
+	cgltf_free(model);
+	return true;
+}
+
+bool ReadFile(const std::string &path, std::vector<uint8_t> &data)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file) {
+		return false;
+	}
+	data.resize(file.tellg());
+	file.seekg(0);
+	file.read((char *)data.data(), data.size());
+	return (bool)file;
+}
\ No newline at end of file
@@ -0,0 +1,282 @@
+#include <RayTracer/Scene.h>
+
+#include <RayTracerLib/Metrics.hpp>
+
+#include <glad/glad.h>
+#include <tracy/Tracy.hpp>
+#include <tracy/TracyOpenGL.hpp>
+
+#include <algorithm>
+
+// Initial pool capacities, the pool grows when models need more
+static constexpr uint32_t INITIAL_VERTEX_CAPACITY = 1 << 18;
+static constexpr uint32_t INITIAL_INDEX_CAPACITY = 1 << 20;
+
+// Tells OpenGL how to interpret each vertex attribute,
+// it maps to the "layout (location = N) in vecN position/normal/..." in our vertex shader
+static GeometryPoolCreateInfo PoolCreateInfo(const SceneCreateInfo &info)
+{
+	GeometryPoolCreateInfo poolInfo;
+	if (info.vertexFormat == VertexFormat::Compact) {
+		// Normalized integers are converted to floats by the vertex fetch,
+		// the shader only has to dequantize the position and unpack the octahedral vectors
+		poolInfo.attributes = {
+			{ 0, 4, GL_UNSIGNED_SHORT, true,
+			  offsetof(CompactVertex, position) },
+			{ 1, 2, GL_SHORT, true, offsetof(CompactVertex, normal) },
+			{ 2, 2, GL_HALF_FLOAT, false, offsetof(CompactVertex, uv) },
+			{ 3, 2, GL_SHORT, true, offsetof(CompactVertex, tangent) },
+		};
+		poolInfo.vertexStride = sizeof(CompactVertex);
+	} else {
+		poolInfo.attributes = {
+			{ 0, 3, GL_FLOAT, false, offsetof(Vertex, position) },
+			{ 1, 3, GL_FLOAT, false, offsetof(Vertex, normal) },
+			{ 2, 2, GL_FLOAT, false, offsetof(Vertex, uv) },
+			{ 3, 4, GL_FLOAT, false, offsetof(Vertex, tangent) },
+		};
+		poolInfo.vertexStride = sizeof(Vertex);
+	}
+	poolInfo.indexSize =
+		info.shortIndices ? sizeof(uint16_t) : sizeof(uint32_t);
+	poolInfo.vertexCapacity = INITIAL_VERTEX_CAPACITY;
+	poolInfo.indexCapacity = INITIAL_INDEX_CAPACITY;
+	return poolInfo;
+}
+
+static void RecordTextureMetrics(const TextureStreamerStats &stats)
+{
+	static const MetricGauge residentGauge("textures.resident_bytes",
+					       "bytes");
+	static const MetricGauge requestedGauge("textures.requested_bytes",
+						"bytes");
+	static const MetricGauge budgetGauge("textures.budget_bytes", "bytes");
+	static const MetricGauge pendingGauge("textures.pending_requests");
+	// The streamer counts evictions since it was created
+	static const MetricGauge evictionGauge("textures.evictions");
+	residentGauge.Set(stats.residentBytes);
+	requestedGauge.Set(stats.requestedBytes);
+	budgetGauge.Set(stats.budgetBytes);
+	pendingGauge.Set(stats.pendingRequests);
+	evictionGauge.Set(stats.evictions);
+}
+
+// Gauges hold the last frame, the counters add up to rates over the overlay's window
+static void RecordDrawMetrics(const SceneDrawStats &stats)
+{
+	static const MetricGauge drawCallGauge("scene.draw_calls");
+	static const MetricGauge drawGauge("scene.draws");
+	static const MetricGauge triangleGauge("scene.triangles");
+	static const MetricCounter triangleCounter("scene.triangles_drawn");
+	static const MetricCounter uploadCounter("gpu.uploaded_bytes", "bytes");
+	drawCallGauge.Set(stats.drawCalls);
+	drawGauge.Set(stats.draws);
+	triangleGauge.Set(stats.triangles);
+	triangleCounter.Add(stats.triangles);
+	uploadCounter.Add(stats.uploadedBytes);
+}
+
+Scene::Scene(const SceneCreateInfo &info)
+	: _info(info)
+	, _pool(PoolCreateInfo(info))
+	, _streamer(info.streaming)
+{
+	glCreateBuffers(1, &_objectData);
+	glCreateBuffers(1, &_transformData);
+	glCreateBuffers(1, &_commands);
+}
+
+Scene::~Scene()
+{
+	// Models free their ranges in the pool and their textures, so they must go first
+	_models.clear();
+	glDeleteBuffers(1, &_commands);
+	glDeleteBuffers(1, &_transformData);
+	glDeleteBuffers(1, &_objectData);
+}
+
+Model *Scene::Load(std::string_view path, ModelLoadOptions options)
+{
+	ZoneScoped;
+	options.vertexFormat = _info.vertexFormat;
+	auto model = std::make_unique<Model>(path, _pool, _streamer, options);
+	return _models.emplace_back(std::move(model)).get();
+}
+
+void Scene::Unload(const Model *model)
+{
+	std::erase_if(_models, [&](const std::unique_ptr<Model> &other) {
+		return other.get() == model;
+	});
+}
+
+void Scene::Animate(double seconds)
+{
+	ZoneScoped;
+	static const MetricTimer animateTimer("scene.animate");
+	const MetricScope scope(animateTimer);
+	for (const auto &model : _models) {
+		model->Animate(seconds);
+	}
+}
+
+// Copies the world matrices of every block, or only the ones that moved when the buffer already
+// holds the same blocks at the same places
+static void CopyTransforms(SceneFrame &frame,
+			   std::vector<TransformBlock> &uploadedBlocks,
+			   uint32_t &uploadedTransforms)
+{
+	ZoneScoped;
+	const auto &drawList = frame.drawList;
+	const auto &blocks = drawList.transformBlocks;
+	frame.transformRanges.clear();
+	frame.transforms.clear();
+	// A model was loaded, unloaded or reloaded, everything moves
+	frame.reallocateTransforms =
+		uploadedTransforms != drawList.transformCount ||
+		!std::equal(blocks.begin(), blocks.end(), uploadedBlocks.begin(),
+			    uploadedBlocks.end(),
+			    [](const TransformBlock &a, const TransformBlock &b) {
+				    return a.hierarchy == b.hierarchy &&
+					   a.first == b.first &&
+					   a.generation == b.generation;
+			    });
+	for (const auto &block : blocks) {
+		const auto &worlds = block.hierarchy->WorldMatrices();
+		if (frame.reallocateTransforms) {
+			frame.transformRanges.emplace_back(TransformRange{
+				block.first, (uint32_t)worlds.size() });
+			frame.transforms.insert(frame.transforms.end(),
+						worlds.begin(), worlds.end());
+			continue;
+		}
+		for (const auto &range : block.hierarchy->DirtyRanges()) {
+			frame.transformRanges.emplace_back(TransformRange{
+				block.first + range.first, range.count });
+			frame.transforms.insert(
+				frame.transforms.end(),
+				worlds.begin() + range.first,
+				worlds.begin() + range.first + range.count);
+		}
+	}
+	uploadedBlocks = blocks;
+	uploadedTransforms = drawList.transformCount;
+}
+
+void Scene::Prepare(const ModelDrawView &view, SceneFrame &frame)
+{
+	ZoneScoped;
+	auto &drawList = frame.drawList;
+	drawList.objects.clear();
+	drawList.commands.clear();
+	drawList.baseColorTextures.clear();
+	drawList.textureRequests.clear();
+	drawList.transformBlocks.clear();
+	drawList.transformCount = 0;
+	for (const auto &model : _models) {
+		model->AppendDraws(drawList, view);
+	}
+	BuildBatches(drawList, frame.batches);
+	CopyTransforms(frame, _uploadedBlocks, _uploadedTransforms);
+}
+
+void Scene::InvalidateTransforms()
+{
+	// No block matches, the buffer is allocated again and filled
+	_uploadedBlocks.clear();
+	_uploadedTransforms = 0;
+}
+
+SceneDrawStats Scene::Submit(Shader &shader, const SceneFrame &frame)
+{
+	ZoneScoped;
+	SceneDrawStats stats;
+	// Apply the frame's texture requests first, texture handles change when levels come and go
+	for (const auto &request : frame.drawList.textureRequests) {
+		_streamer.Request(request.texture, request.level);
+	}
+	_streamer.Update();
+	stats.uploadedBytes = _streamer.Stats().uploadedBytes;
+	RecordTextureMetrics(_streamer.Stats());
+
+	// Copy the frame's data to the GPU, once for the whole scene
+	if (frame.reallocateTransforms) {
+		glNamedBufferData(_transformData,
+				  frame.drawList.transformCount *
+					  sizeof(glm::mat4),
+				  nullptr, GL_DYNAMIC_DRAW);
+	}
+	const glm::mat4 *transforms = frame.transforms.data();
+	for (const auto &range : frame.transformRanges) {
+		glNamedBufferSubData(_transformData,
+				     range.first * sizeof(glm::mat4),
+				     range.count * sizeof(glm::mat4),
+				     transforms);
+		transforms += range.count;
+	}
+	stats.uploadedBytes += frame.transforms.size() * sizeof(glm::mat4);
+	if (frame.drawList.commands.empty()) {
+		RecordDrawMetrics(stats);
+		return stats;
+	}
+
+	const auto &batchTextures = frame.batches.textures;
+	const auto &batchOffsets = frame.batches.offsets;
+	const auto &commands = frame.batches.commands;
+	stats.triangles = frame.batches.triangles;
+	stats.uploadedBytes +=
+		frame.drawList.objects.size() * sizeof(ObjectData) +
+		commands.size() * sizeof(MeshIndirectInfo);
+	glNamedBufferData(_objectData,
+			  frame.drawList.objects.size() * sizeof(ObjectData),
+			  frame.drawList.objects.data(), GL_DYNAMIC_DRAW);
+	glNamedBufferData(_commands,
+			  commands.size() * sizeof(MeshIndirectInfo),
+			  commands.data(), GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, _objectData);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, _transformData);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _commands);
+
+	// Bind the shader because we will be setting uniforms now
+	shader.Bind();
+	_pool.Bind();
+	// For each batch
+	for (uint32_t batch = 0; batch < batchTextures.size(); ++batch) {
+		TracyGpuZone("Batch");
+		// Set all the active textures for this batch
+		for (uint32_t slot = 0; slot < batchTextures[batch].size();
+		     ++slot) {
+			shader.Set(2 + slot, (int32_t)slot);
+			glActiveTexture(GL_TEXTURE0 + slot);
+			glBindTexture(GL_TEXTURE_2D,
+				      _streamer.Handle(
+					      batchTextures[batch][slot]));
+		}
+		// Issue the draw call for this batch's range of the indirect buffer
+		const auto first = batchOffsets[batch];
+		const auto count = batchOffsets[batch + 1] - first;
+		glMultiDrawElementsIndirect(
+			GL_TRIANGLES, _pool.IndexType(),
+			(const void *)(first * sizeof(MeshIndirectInfo)),
+			count, sizeof(MeshIndirectInfo));
+		stats.drawCalls++;
+	}
+	stats.draws = commands.size();
+	RecordDrawMetrics(stats);
+	return stats;
+}
+
+const std::vector<std::unique_ptr<Model> > &Scene::Models() const
+{
+	return _models;
+}
+
+GeometryPoolStats Scene::PoolStats() const
+{
+	return _pool.Stats();
+}
+
+TextureStreamer &Scene::Streamer()
+{
+	return _streamer;
+}
\ No newline at end of file
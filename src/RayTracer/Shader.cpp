@@ -1,9 +1,16 @@
 #include <RayTracer/Shader.h>
 
+#include <RayTracerLib/FileWatcher.hpp>
+#include <RayTracerLib/Hash.hpp>
+#include <RayTracerLib/Metrics.hpp>
+
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <spdlog/spdlog.h>
+#include <tracy/Tracy.hpp>
 
+#include <filesystem>
 #include <fstream>
 #include <string>
 
@@ -11,75 +18,262 @@
 static std::string Slurp(std::string_view path)
 {
 	std::ifstream file(path.data(), std::ios::ate);
+	if (!file) {
+		spdlog::error("Shader: Unable to read {}", path);
+		return {};
+	}
 	std::string result(file.tellg(), '\0');
 	file.seekg(0);
 	file.read((char *)result.data(), result.size());
 	return result;
 }
 
-Shader::Shader(std::string_view vertex, std::string_view fragment)
+// Inserts the defines right after the #version line, which must stay first
+static std::string InjectDefines(const std::string &source,
+				 const std::vector<std::string> &defines)
+{
+	if (defines.empty()) {
+		return source;
+	}
+	std::string lines;
+	for (const auto &define : defines) {
+		lines += "#define " + define + "\n";
+	}
+	const auto version = source.find("#version");
+	if (version == std::string::npos) {
+		return lines + source;
+	}
+	const auto lineEnd = source.find('\n', version);
+	if (lineEnd == std::string::npos) {
+		return source + "\n" + lines;
+	}
+	return source.substr(0, lineEnd + 1) + lines +
+	       source.substr(lineEnd + 1);
+}
+
+// Binaries only work with the driver that produced them, so it is part of the key
+static uint64_t DriverHash()
+{
+	uint64_t hash = 0;
+	for (const auto name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+		const auto *string = (const char *)glGetString(name);
+		hash = HashCombine(hash, HashString(string ? string : ""));
+	}
+	return hash;
+}
+
+static uint32_t CompileShader(uint32_t type, const std::string &source)
+{
+	ZoneScoped;
+	const char *sourcePtr = source.c_str();
+	// Calls OpenGL to make a new shader handle
+	const auto shader = glCreateShader(type);
+	// Associate the shader source to the shader handle
+	glShaderSource(shader, 1, &sourcePtr, nullptr);
+	// Compile the shader, with GL_KHR_parallel_shader_compile this returns right away
+	glCompileShader(shader);
+	return shader;
+}
+
+// Returns false and logs the error if the shader didn't compile
+static bool CheckShader(uint32_t shader, const std::string &name)
 {
 	// Used to check the compilation status of the shader.
 	int success = false;
-	// Holds the compiler error messages, in case of an error.
-	char log[1024] = {};
-
-	// Reads the vertex shader
-	const auto vertexShaderSource = Slurp(vertex);
-	const char *vertexShaderSourcePtr = vertexShaderSource.c_str();
-	// Calls OpenGL to make a new vertex shader handle
-	const auto vertexShader = glCreateShader(GL_VERTEX_SHADER);
-	// Associate the shader source to the vertex shader handle
-	glShaderSource(vertexShader, 1, &vertexShaderSourcePtr, nullptr);
-	// Compile the shader
-	glCompileShader(vertexShader);
-	// Get compilation status
-	glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-	// If there was an error, print it
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+	// If there was an error, log it
 	if (!success) {
-		glGetShaderInfoLog(vertexShader, 1024, NULL, log);
-		std::printf("%s\n", log);
-	}
-
-	// Reads the fragment shader
-	const auto fragmentShaderSource = Slurp(fragment);
-	const char *fragmentShaderSourcePtr = fragmentShaderSource.c_str();
-	// Calls OpenGL to make a new fragment shader handle
-	const auto fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-	// Associate the shader source to the vertex shader handle
-	glShaderSource(fragmentShader, 1, &fragmentShaderSourcePtr, nullptr);
-	// Compile the shader
-	glCompileShader(fragmentShader);
-	// Get compilation status
-	glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-	if (!success) {
-		glGetShaderInfoLog(fragmentShader, 1024, NULL, log);
-		std::printf("%s\b", log);
+		// Holds the compiler error messages, in case of an error.
+		char log[1024] = {};
+		glGetShaderInfoLog(shader, 1024, NULL, log);
+		spdlog::error("Shader: Unable to compile {}: {}", name, log);
 	}
+	return success;
+}
+
+Shader::Shader(std::string_view vertex, std::string_view fragment,
+	       const ShaderOptions &options)
+	: _vertexPath(CanonicalPath(vertex))
+	, _fragmentPath(CanonicalPath(fragment))
+	, _name(std::string(vertex) + " + " + std::string(fragment))
+	, _start(std::chrono::steady_clock::now())
+{
+	ZoneScoped;
+	ZoneText(_name.c_str(), _name.size());
+	// Reads the vertex and fragment shaders
+	const auto vertexShaderSource =
+		InjectDefines(Slurp(vertex), options.defines);
+	const auto fragmentShaderSource =
+		InjectDefines(Slurp(fragment), options.defines);
 
 	// Create the shader program, also called "pipeline" in other APIs
 	_program = glCreateProgram();
+
+	if (!options.cacheDirectory.empty()) {
+		// The defines are already in the sources
+		auto key = HashCombine(HashString(vertexShaderSource),
+				       HashString(fragmentShaderSource));
+		key = HashCombine(key, DriverHash());
+		_cachePath = (std::filesystem::path(options.cacheDirectory) /
+			      fmt::format("{:016x}.bin", key))
+				     .string();
+
+		// The file holds the binary format followed by the binary
+		std::ifstream file(_cachePath, std::ios::binary | std::ios::ate);
+		if (file && file.tellg() > (std::streamoff)sizeof(uint32_t)) {
+			ZoneScopedN("Shader: Load binary");
+			std::vector<char> binary((size_t)file.tellg() -
+						 sizeof(uint32_t));
+			uint32_t format = 0;
+			file.seekg(0);
+			file.read((char *)&format, sizeof(format));
+			file.read(binary.data(), binary.size());
+			glProgramBinary(_program, format, binary.data(),
+					binary.size());
+			int success = false;
+			glGetProgramiv(_program, GL_LINK_STATUS, &success);
+			if (file && success) {
+				static const MetricTimer cacheTimer(
+					"shader.cache_load");
+				_ready = true;
+				_linked = true;
+				const auto milliseconds =
+					std::chrono::duration<double, std::milli>(
+						std::chrono::steady_clock::now() -
+						_start)
+						.count();
+				cacheTimer.Record(milliseconds);
+				spdlog::info(
+					"Shader: Loaded {} from the cache in {:.2f} ms",
+					_name, milliseconds);
+				return;
+			}
+			// A driver update invalidates binaries, the program is compiled again and the file replaced
+			spdlog::warn("Shader: Cached binary of {} was rejected",
+				     _name);
+		}
+	}
+
+	// Reading the sources and the cache isn't part of the compile time
+	_compileStart = std::chrono::steady_clock::now();
+	_vertexShader = CompileShader(GL_VERTEX_SHADER, vertexShaderSource);
+	_fragmentShader =
+		CompileShader(GL_FRAGMENT_SHADER, fragmentShaderSource);
 	// Attach both the vertex and the fragment shader to the program
-	glAttachShader(_program, vertexShader);
-	glAttachShader(_program, fragmentShader);
+	glAttachShader(_program, _vertexShader);
+	glAttachShader(_program, _fragmentShader);
+	// We want to be able to get the binary back once linked
+	glProgramParameteri(_program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+			    GL_TRUE);
 	glLinkProgram(_program);
+}
+
+Shader::~Shader()
+{
+	if (!_ready) {
+		glDeleteShader(_vertexShader);
+		glDeleteShader(_fragmentShader);
+	}
+	glDeleteProgram(_program);
+}
+
+bool Shader::IsReady()
+{
+	if (_ready) {
+		return true;
+	}
+	// Without the extension the status would be undefined, wait for the compilation instead
+	if (!GLAD_GL_KHR_parallel_shader_compile) {
+		Finish();
+		return true;
+	}
+	int complete = false;
+	glGetProgramiv(_program, GL_COMPLETION_STATUS_KHR, &complete);
+	if (complete) {
+		Finish();
+	}
+	return _ready;
+}
+
+void Shader::Finish()
+{
+	ZoneScoped;
+	ZoneText(_name.c_str(), _name.size());
+	// Querying the statuses waits for the compiler threads. Both are checked, so both log their errors.
+	const bool vertexCompiled = CheckShader(_vertexShader, _name);
+	const bool fragmentCompiled = CheckShader(_fragmentShader, _name);
+	const bool compiled = vertexCompiled && fragmentCompiled;
 	// Get link status
+	int success = false;
 	glGetProgramiv(_program, GL_LINK_STATUS, &success);
-	// If linking failed, display the error message
-	if (!success) {
+	// Compiling and linking are done here. When IsReady saw GL_COMPLETION_STATUS_KHR they were
+	// done by that poll, so the time is at most one poll late.
+	const auto end = std::chrono::steady_clock::now();
+	// If linking failed, log the error message
+	if (compiled && !success) {
+		char log[1024] = {};
 		glGetProgramInfoLog(_program, 1024, NULL, log);
-		std::printf("%s\b", log);
+		spdlog::error("Shader: Unable to link {}: {}", _name, log);
 	}
 
 	// Delete the shader handles, since we have our program they are unnecessary
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
+	glDeleteShader(_vertexShader);
+	glDeleteShader(_fragmentShader);
+	_vertexShader = 0;
+	_fragmentShader = 0;
+	_ready = true;
+	_linked = compiled && success;
+
+	// Ready after also counts reading the sources and the cache lookup
+	static const MetricTimer compileTimer("shader.compile");
+	const auto milliseconds =
+		std::chrono::duration<double, std::milli>(end - _compileStart)
+			.count();
+	const auto readyMilliseconds =
+		std::chrono::duration<double, std::milli>(end - _start).count();
+	compileTimer.Record(milliseconds);
+	spdlog::info("Shader: Compiled {} in {:.2f} ms, ready after {:.2f} ms",
+		     _name, milliseconds, readyMilliseconds);
+
+	// Drivers without any binary format report a length of 0
+	int length = 0;
+	glGetProgramiv(_program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (!success || _cachePath.empty() || length <= 0) {
+		return;
+	}
+	ZoneScopedN("Shader: Store binary");
+	std::vector<char> binary(length);
+	uint32_t format = 0;
+	glGetProgramBinary(_program, length, &length, &format, binary.data());
+
+	std::error_code error;
+	std::filesystem::create_directories(
+		std::filesystem::path(_cachePath).parent_path(), error);
+	std::ofstream file(_cachePath, std::ios::binary);
+	file.write((const char *)&format, sizeof(format));
+	file.write(binary.data(), length);
+	if (error || !file) {
+		spdlog::error("Shader: Unable to write {}", _cachePath);
+	}
 }
 
-Shader::~Shader() = default;
+bool Shader::IsLinked() const
+{
+	return _linked;
+}
+
+bool Shader::DependsOn(const std::filesystem::path &path) const
+{
+	const auto canonical = CanonicalPath(path);
+	return canonical == _vertexPath || canonical == _fragmentPath;
+}
 
-void Shader::Bind() const
+void Shader::Bind()
 {
+	// The first draw with this program waits for it to be compiled
+	if (!_ready) {
+		Finish();
+	}
 	glUseProgram(_program);
 }
 
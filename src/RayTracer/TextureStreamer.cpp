@@ -0,0 +1,393 @@
+#include <RayTracer/TextureStreamer.h>
+
+#include <RayTracerLib/TextureCache.hpp>
+
+#include <glad/glad.h>
+#include <spdlog/spdlog.h>
+#include <tracy/Tracy.hpp>
+
+#include <algorithm>
+#include <queue>
+#include <tuple>
+
+uint32_t TextureInternalFormat(TextureFormat format)
+{
+	switch (format) {
+	case TextureFormat::BC1:
+		return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	case TextureFormat::BC5:
+		return GL_COMPRESSED_RG_RGTC2;
+	case TextureFormat::BC7:
+		return GL_COMPRESSED_RGBA_BPTC_UNORM;
+	default:
+		return GL_RGBA8;
+	}
+}
+
+bool IsTextureFormatSupported(TextureFormat format)
+{
+	int32_t supported = GL_FALSE;
+	glGetInternalformativ(GL_TEXTURE_2D, TextureInternalFormat(format),
+			      GL_INTERNALFORMAT_SUPPORTED, 1, &supported);
+	return supported == GL_TRUE;
+}
+
+TextureStreamer::TextureStreamer(const TextureStreamerCreateInfo &info)
+	: _info(info)
+	, _loader([this](std::stop_token stopToken) {
+		LoaderThread(stopToken);
+	})
+{
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	// Stop the loader before the textures go away, it never touches OpenGL
+	_loader.request_stop();
+	_loader.join();
+	for (const auto &texture : _textures) {
+		if (texture.used) {
+			glDeleteTextures(1, &texture.handle);
+		}
+	}
+}
+
+// Reads the levels of a request, on the loader thread or in Update when synchronous
+static bool LoadRequestLevels(const std::filesystem::path &source,
+			      uint32_t firstLevel, uint32_t count,
+			      TextureData &data)
+{
+	ZoneScopedN("TextureStreamer: Load levels");
+	return TextureCache::LoadLevels(source, firstLevel, count, data) &&
+	       data.levels.size() == count;
+}
+
+void TextureStreamer::LoaderThread(std::stop_token stopToken)
+{
+#ifdef TRACY_ENABLE
+	tracy::SetThreadName("Texture loader");
+#endif
+	while (true) {
+		LoadRequest request;
+		{
+			std::unique_lock lock(_mutex);
+			if (!_condition.wait(lock, stopToken, [&] {
+				    return !_requests.empty();
+			    })) {
+				return;
+			}
+			request = std::move(_requests.front());
+			_requests.pop_front();
+		}
+		// Disk reads happen here, so the main thread never waits for them
+		LoadResult result = { request.id, request.generation,
+				      request.firstLevel, false, {} };
+		result.loaded = LoadRequestLevels(request.source,
+						  request.firstLevel,
+						  request.count, result.data);
+		std::lock_guard lock(_mutex);
+		_results.emplace_back(std::move(result));
+	}
+}
+
+uint32_t TextureStreamer::Add(const TextureData &texture,
+			      std::filesystem::path source)
+{
+	uint32_t id;
+	if (!_freeIds.empty()) {
+		id = _freeIds.back();
+		_freeIds.pop_back();
+	} else {
+		id = _textures.size();
+		_textures.emplace_back();
+	}
+	auto &entry = _textures[id];
+	const auto generation = entry.generation + 1;
+	entry = Texture();
+	entry.generation = generation;
+	entry.used = true;
+	entry.format = texture.format;
+	for (const auto &level : texture.levels) {
+		// The levels streamed later may have no data yet
+		entry.levels.emplace_back(LevelInfo{
+			level.width, level.height,
+			TextureLevelSize(texture.format, level.width,
+					 level.height) });
+	}
+	entry.requestedLevel = entry.levels.size();
+	entry.residentLevel = entry.levels.size();
+
+	// Streamed textures start with the levels that fit in the initial size
+	uint32_t firstLevel = 0;
+	if (!source.empty()) {
+		while (firstLevel + 1 < entry.levels.size() &&
+		       std::max(entry.levels[firstLevel].width,
+				entry.levels[firstLevel].height) >
+			       _info.initialSize) {
+			++firstLevel;
+		}
+	}
+	entry.source = std::move(source);
+	entry.minimumLevel = firstLevel;
+	Reside(entry, firstLevel, &texture, 0);
+	_stats.textureCount++;
+	return id;
+}
+
+void TextureStreamer::Release(uint32_t id)
+{
+	auto &texture = _textures[id];
+	if (!texture.used) {
+		return;
+	}
+	glDeleteTextures(1, &texture.handle);
+	_stats.residentBytes -= LevelBytes(texture, texture.residentLevel);
+	_stats.textureCount--;
+	// Keep the generation, a load still in flight must not match the next texture in this slot
+	const auto generation = texture.generation;
+	texture = Texture();
+	texture.generation = generation;
+	_freeIds.emplace_back(id);
+}
+
+uint32_t TextureStreamer::Handle(uint32_t id) const
+{
+	return _textures[id].handle;
+}
+
+uint32_t TextureStreamer::InitialSize() const
+{
+	return _info.initialSize;
+}
+
+uint32_t TextureStreamer::Size(uint32_t id) const
+{
+	const auto &level = _textures[id].levels.front();
+	return std::max(level.width, level.height);
+}
+
+void TextureStreamer::Request(uint32_t id, uint32_t level)
+{
+	auto &texture = _textures[id];
+	texture.requestedLevel = std::min(texture.requestedLevel, level);
+}
+
+size_t TextureStreamer::LevelBytes(const Texture &texture,
+				   uint32_t firstLevel) const
+{
+	size_t bytes = 0;
+	for (uint32_t level = firstLevel; level < texture.levels.size();
+	     ++level) {
+		bytes += texture.levels[level].size;
+	}
+	return bytes;
+}
+
+void TextureStreamer::Reside(Texture &texture, uint32_t firstLevel,
+			     const TextureData *data, uint32_t dataFirstLevel)
+{
+	ZoneScoped;
+	const auto internalFormat = TextureInternalFormat(texture.format);
+	const auto &base = texture.levels[firstLevel];
+	// Ask OpenGL to give us a new texture handle
+	uint32_t handle;
+	glCreateTextures(GL_TEXTURE_2D, 1, &handle);
+
+	// Sets the texture's sampler's parameters
+	// if you are not familiar with these, LearnOpenGL.com has a great tutorial
+	glTextureParameteri(handle, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTextureParameteri(handle, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTextureParameteri(handle, GL_TEXTURE_MIN_FILTER,
+			    GL_LINEAR_MIPMAP_LINEAR);
+	glTextureParameteri(handle, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	// Allocate the resident levels only, level 0 of the OpenGL texture is `firstLevel`
+	glTextureStorage2D(handle, texture.levels.size() - firstLevel,
+			   internalFormat, base.width, base.height);
+
+	for (uint32_t level = firstLevel; level < texture.levels.size();
+	     ++level) {
+		const auto &info = texture.levels[level];
+		if (level < texture.residentLevel) {
+			// A level we don't have yet
+			const auto &source =
+				data->levels[level - dataFirstLevel];
+			// Copy our texture data to the GPU
+			if (texture.format == TextureFormat::RGBA8) {
+				glTextureSubImage2D(handle, level - firstLevel,
+						    0, 0, info.width,
+						    info.height, GL_RGBA,
+						    GL_UNSIGNED_BYTE,
+						    source.data.data());
+			} else {
+				glCompressedTextureSubImage2D(
+					handle, level - firstLevel, 0, 0,
+					info.width, info.height,
+					internalFormat, source.data.size(),
+					source.data.data());
+			}
+			_stats.uploadedBytes += info.size;
+		} else {
+			// Already resident, copy it on the GPU
+			glCopyImageSubData(texture.handle, GL_TEXTURE_2D,
+					   level - texture.residentLevel, 0, 0,
+					   0, handle, GL_TEXTURE_2D,
+					   level - firstLevel, 0, 0, 0,
+					   info.width, info.height, 1);
+		}
+	}
+
+	if (texture.handle) {
+		glDeleteTextures(1, &texture.handle);
+	}
+	_stats.residentBytes -= LevelBytes(texture, texture.residentLevel);
+	_stats.residentBytes += LevelBytes(texture, firstLevel);
+	texture.handle = handle;
+	texture.residentLevel = firstLevel;
+}
+
+void TextureStreamer::Update()
+{
+	ZoneScoped;
+	_stats.uploadedBytes = 0;
+
+	// Pick the level every texture should have: what was requested, or what it has if it wasn't
+	// drawn (it's likely to be drawn again soon), but never coarser than its initial levels
+	std::vector<uint32_t> targets(_textures.size());
+	size_t targetBytes = 0;
+	for (uint32_t id = 0; id < _textures.size(); ++id) {
+		auto &texture = _textures[id];
+		if (!texture.used) {
+			continue;
+		}
+		if (texture.source.empty()) {
+			targets[id] = texture.residentLevel;
+		} else if (texture.requestedLevel < texture.levels.size()) {
+			targets[id] = std::min(texture.requestedLevel,
+					       texture.minimumLevel);
+		} else {
+			targets[id] = texture.residentLevel;
+		}
+		targetBytes += LevelBytes(texture, targets[id]);
+	}
+	_stats.requestedBytes = targetBytes;
+	_stats.budgetBytes = _info.budgetBytes;
+
+	// Over budget, drop the finest level of the biggest textures first, starting with the ones
+	// that weren't drawn since the last update
+	if (targetBytes > _info.budgetBytes) {
+		using Candidate = std::tuple<bool, size_t, uint32_t>;
+		std::priority_queue<Candidate> candidates;
+		for (uint32_t id = 0; id < _textures.size(); ++id) {
+			const auto &texture = _textures[id];
+			if (texture.used && targets[id] < texture.minimumLevel) {
+				candidates.emplace(
+					texture.requestedLevel ==
+						texture.levels.size(),
+					texture.levels[targets[id]].size, id);
+			}
+		}
+		while (targetBytes > _info.budgetBytes && !candidates.empty()) {
+			const auto [unused, size, id] = candidates.top();
+			candidates.pop();
+			const auto &texture = _textures[id];
+			targetBytes -= size;
+			if (++targets[id] < texture.minimumLevel) {
+				candidates.emplace(
+					unused, texture.levels[targets[id]].size,
+					id);
+			}
+		}
+	}
+
+	// Evict right away, it's a GPU copy. Loads go to the loader thread.
+	std::vector<LoadRequest> requests;
+	for (uint32_t id = 0; id < _textures.size(); ++id) {
+		auto &texture = _textures[id];
+		if (!texture.used) {
+			continue;
+		}
+		if (targets[id] > texture.residentLevel) {
+			Reside(texture, targets[id], nullptr, 0);
+			_stats.evictions++;
+		} else if (targets[id] < texture.residentLevel &&
+			   !texture.pending) {
+			requests.emplace_back(LoadRequest{
+				id, texture.generation, texture.source,
+				targets[id],
+				texture.residentLevel - targets[id] });
+			texture.pending = true;
+		}
+		texture.requestedLevel = texture.levels.size();
+	}
+
+	if (_info.synchronous) {
+		for (const auto &request : requests) {
+			auto &result = _deferred.emplace_back(
+				LoadResult{ request.id, request.generation,
+					    request.firstLevel, false, {} });
+			result.loaded = LoadRequestLevels(request.source,
+							  request.firstLevel,
+							  request.count,
+							  result.data);
+		}
+		requests.clear();
+	}
+	{
+		std::lock_guard lock(_mutex);
+		_requests.insert(_requests.end(),
+				 std::make_move_iterator(requests.begin()),
+				 std::make_move_iterator(requests.end()));
+		for (auto &result : _results) {
+			_deferred.emplace_back(std::move(result));
+		}
+		_results.clear();
+		_stats.pendingRequests = _requests.size();
+	}
+	if (!requests.empty()) {
+		_condition.notify_one();
+	}
+
+	// Upload the finished loads, as long as the frame's upload budget allows it
+	while (!_deferred.empty()) {
+		auto &result = _deferred.front();
+		if (result.id >= _textures.size() ||
+		    _textures[result.id].generation != result.generation) {
+			// Released while it was loading
+			_deferred.pop_front();
+			continue;
+		}
+		auto &texture = _textures[result.id];
+		size_t bytes = 0;
+		for (const auto &level : result.data.levels) {
+			bytes += level.data.size();
+		}
+		if (!_info.synchronous && _stats.uploadedBytes > 0 &&
+		    _stats.uploadedBytes + bytes > _info.uploadBytesPerFrame) {
+			break;
+		}
+		texture.pending = false;
+		if (!result.loaded) {
+			spdlog::error(
+				"TextureStreamer: Unable to read {}, the texture won't be streamed anymore",
+				texture.source.string());
+			texture.source.clear();
+		} else if (result.firstLevel + result.data.levels.size() ==
+			   texture.residentLevel) {
+			// Skipped if the texture lost levels while loading, the loaded ones wouldn't connect
+			Reside(texture, result.firstLevel, &result.data,
+			       result.firstLevel);
+		}
+		_deferred.pop_front();
+	}
+	_stats.pendingRequests += _deferred.size();
+}
+
+void TextureStreamer::SetBudget(size_t bytes)
+{
+	_info.budgetBytes = bytes;
+}
+
+TextureStreamerStats TextureStreamer::Stats() const
+{
+	return _stats;
+}
\ No newline at end of file
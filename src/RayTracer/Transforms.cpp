@@ -0,0 +1,226 @@
+#include <RayTracer/Transforms.h>
+
+#include <RayTracerLib/Parallel.hpp>
+
+#include <tracy/Tracy.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define TRANSFORMS_SSE
+#endif
+
+// Subtrees smaller than this aren't split or spread over threads, they are done faster than a
+// thread starts
+static constexpr uint32_t MIN_SUBTREE_SIZE = 1024;
+
+// T * R * S written straight into the columns, without building the three matrices
+static glm::mat4 LocalMatrix(const glm::vec3 &translation,
+			     const glm::quat &rotation, const glm::vec3 &scale)
+{
+	const auto x = rotation.x, y = rotation.y, z = rotation.z,
+		   w = rotation.w;
+	glm::mat4 matrix;
+	matrix[0][0] = (1.0f - 2.0f * (y * y + z * z)) * scale.x;
+	matrix[0][1] = 2.0f * (x * y + w * z) * scale.x;
+	matrix[0][2] = 2.0f * (x * z - w * y) * scale.x;
+	matrix[0][3] = 0.0f;
+	matrix[1][0] = 2.0f * (x * y - w * z) * scale.y;
+	matrix[1][1] = (1.0f - 2.0f * (x * x + z * z)) * scale.y;
+	matrix[1][2] = 2.0f * (y * z + w * x) * scale.y;
+	matrix[1][3] = 0.0f;
+	matrix[2][0] = 2.0f * (x * z + w * y) * scale.z;
+	matrix[2][1] = 2.0f * (y * z - w * x) * scale.z;
+	matrix[2][2] = (1.0f - 2.0f * (x * x + y * y)) * scale.z;
+	matrix[2][3] = 0.0f;
+	matrix[3] = glm::vec4(translation, 1.0f);
+	return matrix;
+}
+
+// `result` = `a` * `b`, every column of the result is the columns of `a` weighted by a column of `b`
+static void Multiply(const glm::mat4 &a, const glm::mat4 &b, glm::mat4 &result)
+{
+#ifdef TRANSFORMS_SSE
+	const auto *columns = &a[0][0];
+	const auto a0 = _mm_loadu_ps(columns);
+	const auto a1 = _mm_loadu_ps(columns + 4);
+	const auto a2 = _mm_loadu_ps(columns + 8);
+	const auto a3 = _mm_loadu_ps(columns + 12);
+	for (uint32_t column = 0; column < 4; ++column) {
+		const auto *weights = &b[column][0];
+		auto sum = _mm_mul_ps(a0, _mm_set1_ps(weights[0]));
+		sum = _mm_add_ps(sum, _mm_mul_ps(a1, _mm_set1_ps(weights[1])));
+		sum = _mm_add_ps(sum, _mm_mul_ps(a2, _mm_set1_ps(weights[2])));
+		sum = _mm_add_ps(sum, _mm_mul_ps(a3, _mm_set1_ps(weights[3])));
+		_mm_storeu_ps(&result[column][0], sum);
+	}
+#else
+	result = a * b;
+#endif
+}
+
+uint32_t TransformHierarchy::Add(uint32_t parent, const glm::vec3 &translation,
+				 const glm::quat &rotation,
+				 const glm::vec3 &scale)
+{
+	_parents.emplace_back(parent);
+	_translations.emplace_back(translation);
+	_rotations.emplace_back(rotation);
+	_scales.emplace_back(scale);
+	return _parents.size() - 1;
+}
+
+void TransformHierarchy::Build()
+{
+	const auto count = Size();
+	// Walking backwards, a subtree is complete by the time it is added to its parent
+	_subtreeSizes.assign(count, 1);
+	for (auto node = count; node-- > 0;) {
+		if (_parents[node] != NO_PARENT) {
+			_subtreeSizes[_parents[node]] += _subtreeSizes[node];
+		}
+	}
+	_worlds.resize(count);
+	_worldDirty.assign(count, 0);
+	// The first update computes everything
+	_localDirty.assign(count, 1);
+
+	// Start with the trees of the roots, then split the biggest subtree into its node and its
+	// children's subtrees until there is enough work for every core. The split nodes are done
+	// first, after them every subtree only depends on nodes that are already up to date.
+	_serialNodes.clear();
+	_subtrees.clear();
+	for (uint32_t root = 0; root < count; root += _subtreeSizes[root]) {
+		_subtrees.emplace_back(TransformRange{ root, _subtreeSizes[root] });
+	}
+	const auto target =
+		4 * std::max(std::thread::hardware_concurrency(), 1u);
+	while (_subtrees.size() < target) {
+		const auto largest = std::max_element(
+			_subtrees.begin(), _subtrees.end(),
+			[](const TransformRange &a, const TransformRange &b) {
+				return a.count < b.count;
+			});
+		if (largest == _subtrees.end() ||
+		    largest->count < 2 * MIN_SUBTREE_SIZE) {
+			break;
+		}
+		const auto root = largest->first;
+		const auto end = root + largest->count;
+		_subtrees.erase(largest);
+		_serialNodes.emplace_back(root);
+		for (auto child = root + 1; child < end;
+		     child += _subtreeSizes[child]) {
+			_subtrees.emplace_back(
+				TransformRange{ child, _subtreeSizes[child] });
+		}
+	}
+	std::sort(_serialNodes.begin(), _serialNodes.end());
+	std::sort(_subtrees.begin(), _subtrees.end(),
+		  [](const TransformRange &a, const TransformRange &b) {
+			  return a.first < b.first;
+		  });
+
+	// Neighbouring small subtrees are merged, a range only needs the parents outside of it done
+	std::vector<TransformRange> merged;
+	for (const auto &subtree : _subtrees) {
+		if (!merged.empty() &&
+		    merged.back().first + merged.back().count == subtree.first &&
+		    merged.back().count < MIN_SUBTREE_SIZE) {
+			merged.back().count += subtree.count;
+		} else {
+			merged.emplace_back(subtree);
+		}
+	}
+	_subtrees = std::move(merged);
+}
+
+void TransformHierarchy::SetTranslation(uint32_t node,
+					const glm::vec3 &translation)
+{
+	_translations[node] = translation;
+	// Animation channels of the same node may be sampled on different threads
+	std::atomic_ref(_localDirty[node]).store(1, std::memory_order_relaxed);
+}
+
+void TransformHierarchy::SetRotation(uint32_t node, const glm::quat &rotation)
+{
+	_rotations[node] = rotation;
+	std::atomic_ref(_localDirty[node]).store(1, std::memory_order_relaxed);
+}
+
+void TransformHierarchy::SetScale(uint32_t node, const glm::vec3 &scale)
+{
+	_scales[node] = scale;
+	std::atomic_ref(_localDirty[node]).store(1, std::memory_order_relaxed);
+}
+
+void TransformHierarchy::UpdateRange(uint32_t first, uint32_t count)
+{
+	for (auto node = first; node < first + count; ++node) {
+		const auto parent = _parents[node];
+		// A node moves with its parent, even when its own transform stays the same
+		const bool dirty = _localDirty[node] ||
+				   (parent != NO_PARENT && _worldDirty[parent]);
+		_worldDirty[node] = dirty;
+		if (!dirty) {
+			continue;
+		}
+		const auto local = LocalMatrix(_translations[node],
+					       _rotations[node], _scales[node]);
+		if (parent == NO_PARENT) {
+			_worlds[node] = local;
+		} else {
+			Multiply(_worlds[parent], local, _worlds[node]);
+		}
+	}
+}
+
+void TransformHierarchy::Update()
+{
+	ZoneScoped;
+	for (const auto node : _serialNodes) {
+		UpdateRange(node, 1);
+	}
+	ParallelFor(_subtrees.size(), [&](size_t i) {
+		UpdateRange(_subtrees[i].first, _subtrees[i].count);
+	});
+
+	// Animated nodes tend to be next to each other, so there are few ranges to upload
+	_dirtyRanges.clear();
+	for (uint32_t node = 0; node < Size();) {
+		if (!_worldDirty[node]) {
+			++node;
+			continue;
+		}
+		const auto first = node;
+		while (node < Size() && _worldDirty[node]) {
+			++node;
+		}
+		_dirtyRanges.emplace_back(TransformRange{ first, node - first });
+	}
+	std::fill(_localDirty.begin(), _localDirty.end(), 0);
+}
+
+uint32_t TransformHierarchy::Size() const
+{
+	return _parents.size();
+}
+
+uint32_t TransformHierarchy::Parent(uint32_t node) const
+{
+	return _parents[node];
+}
+
+const std::vector<glm::mat4> &TransformHierarchy::WorldMatrices() const
+{
+	return _worlds;
+}
+
+const std::vector<TransformRange> &TransformHierarchy::DirtyRanges() const
+{
+	return _dirtyRanges;
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <RayTracer/Transforms.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class AnimationPath : uint8_t {
+	Translation,
+	Rotation,
+	Scale,
+};
+
+enum class AnimationInterpolation : uint8_t {
+	Linear,
+	Step,
+	CubicSpline,
+};
+
+// One animated property of one node, like a glTF animation channel and its sampler
+struct AnimationChannel {
+	uint32_t node;
+	AnimationPath path;
+	AnimationInterpolation interpolation;
+	// Key times in seconds, increasing
+	std::vector<float> times;
+	// 3 floats per key for translations and scales, 4 for rotations (x, y, z, w). Cubic spline
+	// keys are an in tangent, the value and an out tangent.
+	std::vector<float> values;
+};
+
+struct Animation {
+	std::string name;
+	// Time of the last key of any channel, the animation loops after it
+	float duration = 0.0f;
+	std::vector<AnimationChannel> channels;
+};
+
+// Samples every channel at `seconds`, looped over the animation's duration, and sets the local
+// transforms of the nodes. Rotations are interpolated with slerp. Channels are sampled in parallel.
+void SampleAnimation(const Animation &animation, double seconds,
+		     TransformHierarchy &hierarchy);
\ No newline at end of file
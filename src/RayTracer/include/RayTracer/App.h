@@ -1,15 +1,18 @@
 #pragma once
 
 #include <RayTracerLib/BaseApp.hpp>
+#include <RayTracerLib/FileWatcher.hpp>
 
-#include <RayTracer/Model.h>
+#include <RayTracer/Scene.h>
 
 #include <glm/mat4x4.hpp>
 #include <glm/vec4.hpp>
 #include <glm/vec3.hpp>
 #include <glm/vec2.hpp>
 
+#include <chrono>
 #include <string_view>
+#include <string>
 #include <vector>
 #include <memory>
 
@@ -18,13 +21,57 @@ class App final : public BaseApp {
 	void AfterCreatedUiContext() override;
 	void BeforeDestroyUiContext() override;
 	bool Load() override;
+	void Unload() override;
 	void RenderScene(float deltaTime) override;
 	void RenderUI(float deltaTime) override;
 	void Update(float deltaTime) override;
+	void BuildFrameGraph(TaskGraph &graph) override;
 
     private:
+	// What the frame graph leaves for RenderScene
+	struct PreparedFrame {
+		glm::mat4 projection;
+		glm::mat4 view;
+		SceneFrame scene;
+	};
+
+	// What a hot reload did and how long after the change was noticed it was done
+	struct ReloadEvent {
+		std::string name;
+		double milliseconds;
+	};
+
+	void LoadScene();
+	// Reloads whatever depends on the files changed since the last frame
+	void ReloadChanges();
+	void RecordReload(std::string name,
+			  std::chrono::steady_clock::time_point changeTime);
+
 	float _elapsedTime = 0.0f;
+	// Paths to the glTF files given on the command line
+	std::vector<std::string> _modelPaths;
+	SceneCreateInfo _sceneInfo;
+	ModelLoadOptions _modelOptions;
+	std::unique_ptr<Shader> _shader;
+	std::unique_ptr<Scene> _scene;
+	// Level of detail selection
+	bool _lodEnabled = true;
+	float _lodErrorThreshold = 1.0f;
+	// Every model plays its first animation, looping. The time is the frame's time minus the
+	// time spent paused, so frames prepared again get the same pose.
+	bool _animate = true;
+	double _animationTime = 0.0;
+	double _animationOffset = 0.0;
+	SceneDrawStats _drawStats;
+	// By frame index, RenderScene draws one while the next one is prepared
+	PreparedFrame _frames[2];
+	// Hot reload, shaders compile in the background and replace the current one once linked
+	FileWatcher _watcher;
+	std::unique_ptr<Shader> _pendingShader;
+	std::chrono::steady_clock::time_point _shaderChangeTime;
+	std::vector<ReloadEvent> _reloads;
 
     public:
-	App() = default;
+	App(std::vector<std::string> modelPaths = {},
+	    const BaseAppOptions &options = {});
 };
\ No newline at end of file
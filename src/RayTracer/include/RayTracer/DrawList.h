@@ -0,0 +1,66 @@
+#pragma once
+
+#include <RayTracer/Mesh.h>
+#include <RayTracer/Transforms.h>
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Number of texture units the fragment shader samples from (`uTextures[16]`)
+static constexpr uint32_t TEXTURES_PER_BATCH = 16;
+
+// Per draw information, the shader finds it with gl_BaseInstance (this should match with the one in the shader)
+struct ObjectData {
+	uint32_t transformIndex;
+	uint32_t baseColorIndex;
+	uint32_t normalIndex;
+	VertexFormat vertexFormat;
+	glm::vec4 positionOffset;
+	glm::vec4 positionScale;
+};
+
+// A model's world matrices and where they start in the scene's transform buffer
+struct TransformBlock {
+	const TransformHierarchy *hierarchy;
+	uint32_t first;
+	// Changes whenever the model imports new transforms, the block is uploaded whole then
+	uint64_t generation;
+};
+
+// A texture level a draw needs, handed to the streamer when the frame is submitted
+struct TextureRequest {
+	uint32_t texture;
+	uint32_t level;
+};
+
+// Everything needed to submit a frame, each model appends its draws to it
+struct DrawList {
+	// One entry per draw, in the same order
+	std::vector<ObjectData> objects;
+	std::vector<MeshIndirectInfo> commands;
+	// Texture streamer id of each draw's base color texture, the OpenGL handles are only looked
+	// up on submit, they change when the streamer updates
+	std::vector<uint32_t> baseColorTextures;
+	std::vector<TextureRequest> textureRequests;
+	// Transforms of every model, back to back, `ObjectData::transformIndex` points in there.
+	// The matrices stay in the models, only what moved since the last frame is uploaded.
+	std::vector<TransformBlock> transformBlocks;
+	uint32_t transformCount = 0;
+};
+
+// The draws of a draw list grouped so that each group uses at most TEXTURES_PER_BATCH textures
+struct DrawBatches {
+	// Textures of each batch, the slot of a texture is its position in its batch
+	std::vector<std::vector<uint32_t> > textures;
+	// Batch `i` is the range [offsets[i], offsets[i + 1]) of `commands`
+	std::vector<uint32_t> offsets;
+	// The draw list's commands sorted by batch
+	std::vector<MeshIndirectInfo> commands;
+	uint64_t triangles = 0;
+};
+
+// Gives every texture a slot in a batch and sorts the commands by batch, so each batch is a
+// contiguous range of the indirect buffer. Sets the texture slots and base instances of `drawList`.
+void BuildBatches(DrawList &drawList, DrawBatches &batches);
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include <glm/glm.hpp>
 
+#include <array>
 #include <cstdint>
 #include <vector>
 
@@ -12,6 +13,35 @@ struct Vertex {
 	glm::vec4 tangent;
 };
 
+// Compact GPU vertex layout (20 bytes instead of 48):
+// - position: unorm16 xyz relative to the mesh bounds, w holds the tangent sign (0 or 1)
+// - normal/tangent: octahedral encoded snorm16
+// - uv: half floats
+struct CompactVertex {
+	uint16_t position[4];
+	int16_t normal[2];
+	int16_t tangent[2];
+	uint16_t uv[2];
+};
+static_assert(sizeof(CompactVertex) == 20);
+
+// The value of each enumerator is what the shader reads from `ObjectData::vertexFormat`
+enum class VertexFormat : uint32_t {
+	Standard = 0,
+	Compact = 1,
+};
+
+// Encodes a vertex in the compact format, positions are quantized in [boundsMin, boundsMax]
+CompactVertex PackVertex(const Vertex &vertex, const glm::vec3 &boundsMin,
+			 const glm::vec3 &boundsMax);
+
+// A simplified version of a mesh, sharing the vertices of the full resolution mesh
+struct MeshLod {
+	std::vector<uint32_t> indices;
+	// Object space error of the simplification
+	float error;
+};
+
 struct MeshCreateInfo {
 	std::vector<Vertex> vertices;
 	std::vector<uint32_t> indices;
@@ -20,6 +50,17 @@ struct MeshCreateInfo {
 	uint32_t normalTexture;
 	size_t vertexOffset;
 	size_t indexOffset;
+	// Object space bounds of the vertices
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
+	// Layout of the data in the GPU buffers, used to turn byte offsets into element offsets
+	VertexFormat vertexFormat;
+	uint32_t vertexStride;
+	uint32_t indexSize;
+	// Number of meshlets, the model holds them
+	uint32_t meshletCount;
+	// Simplified index buffers, stored right after `indices` in the index buffer
+	std::vector<MeshLod> lods;
 };
 
 struct MeshIndirectInfo {
@@ -30,22 +71,51 @@ struct MeshIndirectInfo {
 	uint32_t baseInstance;
 };
 
+// Where a level of detail lives in the index buffer
+struct MeshLodRange {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float error;
+};
+
 class Mesh {
     public:
+	// Level 0 is the full resolution mesh
+	static constexpr uint32_t MAX_LODS = 8;
+
 	Mesh(const MeshCreateInfo &info);
 	~Mesh();
 
-	MeshIndirectInfo Info() const;
+	MeshIndirectInfo Info(uint32_t lod = 0) const;
 	uint32_t TransformIndex() const;
 	uint32_t BaseColorTexture() const;
 	uint32_t NormalTexture() const;
+	// Reloads keep the GPU data of unchanged meshes, but their node or material may have changed
+	void SetTransformIndex(uint32_t transformIndex);
+	void SetBaseColorTexture(uint32_t baseColorTexture);
+	VertexFormat Format() const;
+	// Dequantization parameters: position = offset + stored * scale
+	glm::vec3 PositionOffset() const;
+	glm::vec3 PositionScale() const;
+	uint32_t MeshletCount() const;
+	uint32_t LodCount() const;
+	const MeshLodRange &Lod(uint32_t lod) const;
+	// Object space bounding sphere
+	glm::vec3 BoundsCenter() const;
+	float BoundsRadius() const;
 
     private:
-	uint32_t _indexCount = 0;
 	int32_t _vertexOffset = 0;
-	uint32_t _indexOffset = 0;
+	std::array<MeshLodRange, MAX_LODS> _lods = {};
+	uint32_t _lodCount = 0;
 	// NOT OpenGL handles, just indices
 	uint32_t _transformIndex = 0;
 	uint32_t _baseColorTexture = 0;
 	uint32_t _normalTexture = 0;
+	VertexFormat _format = VertexFormat::Standard;
+	glm::vec3 _positionOffset = glm::vec3(0.0f);
+	glm::vec3 _positionScale = glm::vec3(1.0f);
+	uint32_t _meshletCount = 0;
+	glm::vec3 _boundsCenter = glm::vec3(0.0f);
+	float _boundsRadius = 0.0f;
 };
\ No newline at end of file
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <RayTracer/Mesh.h>
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// A small cluster of triangles, with the bounds needed for cluster culling
+struct Meshlet {
+	// Offsets into the meshlet vertex and triangle arrays of the owning model
+	uint32_t vertexOffset;
+	uint32_t triangleOffset;
+	uint32_t vertexCount;
+	uint32_t triangleCount;
+	// Bounding sphere
+	glm::vec3 center;
+	float radius;
+	// Normal cone, the meshlet is backfacing when
+	// dot(normalize(coneApex - cameraPosition), coneAxis) >= coneCutoff
+	glm::vec3 coneApex;
+	glm::vec3 coneAxis;
+	float coneCutoff;
+};
+
+struct MeshletData {
+	std::vector<Meshlet> meshlets;
+	// Indices into the mesh vertices, `Meshlet::vertexOffset` points in here
+	std::vector<uint32_t> vertices;
+	// Three local (per meshlet) vertex indices per triangle, `Meshlet::triangleOffset` points in here
+	std::vector<uint8_t> triangles;
+};
+
+struct MeshOptimizeOptions {
+	// Reorder triangles for the post-transform cache, then for overdraw, then vertices for fetch locality
+	bool optimize = true;
+	bool buildMeshlets = true;
+};
+
+struct MeshLodOptions {
+	// Number of levels of detail including the full resolution one, 1 disables simplification
+	uint32_t maxLods = 4;
+	// Fraction of triangles each level keeps compared to the previous one
+	float reduction = 0.5f;
+	// Largest simplification error allowed, relative to the mesh extent
+	float maxError = 0.05f;
+};
+
+// Vertex cache efficiency, the counts are kept so they can be summed up across meshes
+struct MeshCacheStats {
+	size_t triangleCount = 0;
+	size_t vertexCount = 0;
+	size_t transformedBefore = 0;
+	size_t transformedAfter = 0;
+
+	// Average cache miss ratio, transformed vertices per triangle (0.5 is the best possible)
+	float AcmrBefore() const;
+	float AcmrAfter() const;
+	// Average transformed vertex ratio, transformed vertices per vertex (1.0 is the best possible)
+	float AtvrBefore() const;
+	float AtvrAfter() const;
+
+	MeshCacheStats &operator+=(const MeshCacheStats &other);
+};
+
+// Optimizes the vertices and indices of a mesh in place, optionally building its meshlets
+MeshCacheStats OptimizeMesh(std::vector<Vertex> &vertices,
+			    std::vector<uint32_t> &indices,
+			    MeshletData &meshlets,
+			    const MeshOptimizeOptions &options);
+
+// Builds progressively simpler index buffers for a mesh with a quadric error simplifier,
+// the returned levels don't include the full resolution one and may be fewer than requested
+// when the mesh can't be simplified any further
+std::vector<MeshLod> BuildLods(const std::vector<Vertex> &vertices,
+			       const std::vector<uint32_t> &indices,
+			       const MeshLodOptions &options);
+
+// Splits a mesh into meshes of at most `maxVertices` vertices each, so they fit 16-bit indices.
+// Triangles keep their order, each part gets its own bounds and `mesh`'s transform, textures and layout.
+std::vector<MeshCreateInfo> SplitMesh(const MeshCreateInfo &mesh,
+				      uint32_t maxVertices);
\ No newline at end of file
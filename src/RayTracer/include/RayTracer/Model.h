@@ -1,31 +1,151 @@
 #pragma once
 
-#include <RayTracer/Shader.h>
+#include <RayTracer/Animation.h>
+#include <RayTracer/DrawList.h>
 #include <RayTracer/Mesh.h>
+#include <RayTracer/MeshProcessing.h>
+#include <RayTracer/TextureStreamer.h>
 
+#include <RayTracerLib/GeometryPool.hpp>
+#include <RayTracerLib/TextureCompression.hpp>
+
+#include <filesystem>
+#include <string>
+#include <unordered_map>
 #include <string_view>
 #include <vector>
 
+struct ModelLoadOptions {
+	// Layout of the vertices in the GPU vertex buffer, it must match the geometry pool
+	VertexFormat vertexFormat = VertexFormat::Standard;
+	// Load-time vertex cache, overdraw and vertex fetch optimization, disable for faster iteration
+	MeshOptimizeOptions optimization;
+	// Levels of detail generated for every mesh, they all share the vertex buffer
+	MeshLodOptions lods;
+	// Base color textures are compressed to this format, RGBA8 is used when the GPU doesn't support it
+	TextureFormat textureFormat = TextureFormat::BC7;
+	// Where compressed textures are cached between runs, caching is disabled when empty
+	std::string textureCacheDirectory = "cache/textures";
+};
+
+// Camera information `Model::AppendDraws` needs to pick levels of detail
+struct ModelDrawView {
+	glm::mat4 projection;
+	glm::mat4 view;
+	// Height of the render target in pixels
+	float viewportHeight;
+	// Largest error allowed on screen in pixels, LOD selection is disabled when <= 0
+	float lodErrorThreshold;
+};
+
+struct ModelStats {
+	size_t vertexBytes = 0;
+	size_t indexBytes = 0;
+	// With every level resident, the streamer decides how much of it is actually in memory
+	size_t textureBytes = 0;
+	// What the textures would use as RGBA8, with their full mip chains
+	size_t uncompressedTextureBytes = 0;
+	double loadMilliseconds = 0.0;
+	// Time spent loading textures, and the part of it spent compressing cache misses
+	double textureLoadMilliseconds = 0.0;
+	double encodeMilliseconds = 0.0;
+	size_t encodedTexels = 0;
+	size_t textureCacheHits = 0;
+	MeshCacheStats cache;
+	// Number of simplified levels generated, not counting the full resolution meshes
+	size_t lodCount = 0;
+	size_t meshletCount = 0;
+	size_t nodeCount = 0;
+	size_t animationCount = 0;
+};
+
+// What the last load or reload did, content that didn't change is kept as it is
+struct ModelReloadStats {
+	uint32_t meshesReused = 0;
+	uint32_t meshesUploaded = 0;
+	uint32_t texturesReused = 0;
+	uint32_t texturesLoaded = 0;
+	double milliseconds = 0.0;
+};
+
 class Model {
     public:
-	Model(std::string_view path);
+	// The geometry is sub-allocated from `pool` and the textures are owned by `streamer`,
+	// both must outlive the model
+	Model(std::string_view path, GeometryPool &pool,
+	      TextureStreamer &streamer, const ModelLoadOptions &options = {});
 	~Model();
 
-	void Draw(const Shader &shader) const;
+	Model(const Model &) = delete;
+	Model &operator=(const Model &) = delete;
+
+	// Reads the file again, only the meshes and textures whose content changed are processed
+	// and uploaded. The current content is kept if the file can't be read.
+	bool Reload();
+	// True if the model was read from `path` (the glTF file, its buffers or its textures)
+	bool DependsOn(const std::filesystem::path &path) const;
+
+	// Poses the model at `seconds` with its first animation, if it has any, and updates the world
+	// matrices of the nodes that moved. Call it once per frame before AppendDraws, with the same
+	// time to pause.
+	void Animate(double seconds);
+	// Appends one draw per mesh, at the level of detail needed for `view`, and the texture levels
+	// these draws need. Only reads the model, it can run on any thread.
+	void AppendDraws(DrawList &drawList, const ModelDrawView &view) const;
+	const ModelStats &Stats() const;
+	const ModelReloadStats &LastReload() const;
+	// Meshlets of the mesh at index `mesh`, the mesh's vertex indices are relative to its base vertex
+	const MeshletData &Meshlets(size_t mesh) const;
+	const std::vector<Animation> &Animations() const;
+	const std::string &Path() const;
 
     private:
+	// What a mesh owns besides its `Mesh`, kept together so unchanged meshes survive a reload
+	struct MeshEntry {
+		// Hash of the imported vertices and indices, before any optimization
+		uint64_t hash = 0;
+		RangeAllocation vertices;
+		RangeAllocation indices;
+		MeshletData meshlets;
+		MeshCacheStats cache;
+	};
+
+	struct TextureEntry {
+		// Hash of the source file and the format, the texture is reused while it matches
+		uint64_t key;
+		// Texture streamer id
+		uint32_t id;
+		size_t bytes;
+		size_t uncompressedBytes;
+	};
+
+	// Imports the file and updates the meshes, textures and transforms that changed
+	bool Import();
+	// Loads, compresses (or fetches from the cache) and uploads the textures that changed, in the order of `paths`
+	void LoadTextures(const std::vector<std::string> &paths);
+
 	// Holds all the meshes that compose the model
 	std::vector<Mesh> _meshes;
-	// Holds OpenGL texture handles
+	// Same order as `_meshes`
+	std::vector<MeshEntry> _meshEntries;
+	// Holds texture streamer ids, `Mesh::BaseColorTexture` indexes this
 	std::vector<uint32_t> _textures;
-	// Holds all the local transforms for each mesh
-	std::vector<glm::mat4> _transforms;
-	// OpenGL buffers
-	uint32_t _vao;
-	uint32_t _vbo;
-	uint32_t _ibo;
-	// These are vectors because we'll be batching our draws
-	std::vector<uint32_t> _cmds;
-	std::vector<uint32_t> _objectData;
-	uint32_t _transformData;
+	// Every texture we loaded, by path
+	std::unordered_map<std::string, TextureEntry> _textureEntries;
+	// Every node of the model, each mesh points to the node it belongs to
+	TransformHierarchy _transforms;
+	std::vector<Animation> _animations;
+	// Unique to every import, tells the scene when our transforms must be uploaded whole
+	uint64_t _transformGeneration = 0;
+	// Time the animation was last sampled at, NaN when the nodes are at rest
+	double _animationSeconds;
+	// Canonical paths of the files the model was read from
+	std::vector<std::filesystem::path> _dependencies;
+	// Where our vertices, indices and textures live
+	GeometryPool &_pool;
+	TextureStreamer &_streamer;
+	std::string _path;
+	ModelLoadOptions _options;
+	ModelStats _stats;
+	ModelReloadStats _lastReload;
 };
\ No newline at end of file
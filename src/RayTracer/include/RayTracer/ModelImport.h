@@ -0,0 +1,32 @@
+#pragma once
+
+#include <RayTracer/Animation.h>
+#include <RayTracer/Mesh.h>
+#include <RayTracer/Transforms.h>
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Everything read from a glTF file, before anything is optimized or sent to the GPU
+struct ModelImportData {
+	// Vertex and index data of every primitive, the GPU layout fields are left to the caller.
+	// `baseColorTexture` indexes `texturePaths` and `transformIndex` is the node in `transforms`.
+	std::vector<MeshCreateInfo> meshes;
+	// Every node of the scene, built and with its world matrices up to date
+	TransformHierarchy transforms;
+	// Channels targeting the nodes' weights or nodes outside of the scene are left out
+	std::vector<Animation> animations;
+	// Base color textures, each path is listed once
+	std::vector<std::string> texturePaths;
+	// Every file the model was read from: the glTF file, its buffers and its textures
+	std::vector<std::string> dependencies;
+};
+
+// Parses a glTF file and converts its primitives to our vertex format, doesn't touch OpenGL
+bool ImportModel(std::string_view path, ModelImportData &data);
+// Reads a whole file, the textures listed by the import are read with it
+bool ReadFile(const std::string &path, std::vector<uint8_t> &data);
\ No newline at end of file
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <RayTracer/DrawList.h>
+#include <RayTracer/Model.h>
+#include <RayTracer/Shader.h>
+
+#include <RayTracerLib/GeometryPool.hpp>
+
+#include <memory>
+#include <string_view>
+#include <vector>
+
+struct SceneCreateInfo {
+	// Layout of the vertices in the geometry pool, every model uses it
+	VertexFormat vertexFormat = VertexFormat::Standard;
+	// 16-bit indices, meshes with more than 65536 vertices are split to fit
+	bool shortIndices = false;
+	TextureStreamerCreateInfo streaming;
+};
+
+struct SceneDrawStats {
+	uint32_t drawCalls = 0;
+	uint32_t draws = 0;
+	uint64_t triangles = 0;
+	// Texture levels streamed in and per-frame buffers, geometry uploads by model loads aren't included
+	size_t uploadedBytes = 0;
+};
+
+// The CPU side of a frame, built by Scene::Prepare on any thread and drawn by Scene::Submit
+struct SceneFrame {
+	DrawList drawList;
+	DrawBatches batches;
+	// World matrices that changed, copied out of the models so they can animate the next frame
+	// while this one is submitted. Range `i` goes to `transformRanges[i].first` in the buffer.
+	std::vector<TransformRange> transformRanges;
+	std::vector<glm::mat4> transforms;
+	// The transform buffer is allocated again for `drawList.transformCount` matrices first
+	bool reallocateTransforms = false;
+};
+
+// Owns the geometry pool, the texture streamer and every model using them, all models are drawn together
+class Scene {
+    public:
+	Scene(const SceneCreateInfo &info);
+	~Scene();
+
+	Scene(const Scene &) = delete;
+	Scene &operator=(const Scene &) = delete;
+
+	Model *Load(std::string_view path, ModelLoadOptions options = {});
+	// Releases the model's geometry and textures, the pool can reuse its space right away
+	void Unload(const Model *model);
+	// Poses every animated model at `seconds` and updates their world matrices
+	void Animate(double seconds);
+	// Builds the draws of every model, without OpenGL. It can run while the previous frame is
+	// submitted, but not while models are loaded or unloaded.
+	void Prepare(const ModelDrawView &view, SceneFrame &frame);
+	// Call when a prepared frame is dropped without being submitted, the next one uploads every matrix
+	void InvalidateTransforms();
+	// Draws a prepared frame with one indirect buffer, textures are bound 16 at a time
+	SceneDrawStats Submit(Shader &shader, const SceneFrame &frame);
+
+	const std::vector<std::unique_ptr<Model> > &Models() const;
+	GeometryPoolStats PoolStats() const;
+	TextureStreamer &Streamer();
+
+    private:
+	SceneCreateInfo _info;
+	GeometryPool _pool;
+	TextureStreamer _streamer;
+	std::vector<std::unique_ptr<Model> > _models;
+	// Blocks in the transform buffer once the prepared frames are submitted, when they match the
+	// next frame's only dirty matrices are uploaded. Cleared by InvalidateTransforms.
+	std::vector<TransformBlock> _uploadedBlocks;
+	uint32_t _uploadedTransforms = 0;
+	// OpenGL buffers
+	uint32_t _objectData = 0;
+	uint32_t _transformData = 0;
+	uint32_t _commands = 0;
+};
@@ -2,17 +2,57 @@
 
 #include <string_view>
 #include <glm/mat4x4.hpp>
+#include <chrono>
+#include <filesystem>
 #include <cstdint>
+#include <string>
+#include <vector>
 
+struct ShaderOptions {
+	// Each entry becomes a "#define <entry>" line right after #version, e.g. "USE_NORMAL_MAPS 1"
+	std::vector<std::string> defines;
+	// Where linked program binaries are cached between runs, caching is disabled when empty
+	std::string cacheDirectory = "cache/shaders";
+};
+
+// A program loaded from its binary cache, or compiled in the background when the driver
+// supports GL_KHR_parallel_shader_compile. Binding it waits for the compilation to be done.
 class Shader {
     public:
-	Shader(std::string_view vertex, std::string_view fragment);
+	Shader(std::string_view vertex, std::string_view fragment,
+	       const ShaderOptions &options = {});
 	~Shader();
 
-	void Bind() const;
+	Shader(const Shader &) = delete;
+	Shader &operator=(const Shader &) = delete;
+
+	// Returns false while the program is still compiling, without GL_KHR_parallel_shader_compile it waits
+	bool IsReady();
+	// Whether the program compiled and linked, only meaningful once ready
+	bool IsLinked() const;
+	// True if `path` is one of the program's sources
+	bool DependsOn(const std::filesystem::path &path) const;
+	void Bind();
 	void Set(uint32_t location, const glm::mat4 &matrix) const;
 	void Set(uint32_t location, int32_t value) const;
 
     private:
-	uint32_t _program;
+	// Checks the compilation results, logs errors and stores the binary in the cache
+	void Finish();
+
+	uint32_t _program = 0;
+	// Only alive while the program compiles
+	uint32_t _vertexShader = 0;
+	uint32_t _fragmentShader = 0;
+	bool _ready = false;
+	bool _linked = false;
+	// Canonical paths of the sources
+	std::filesystem::path _vertexPath;
+	std::filesystem::path _fragmentPath;
+	// Used to name the program in logs
+	std::string _name;
+	std::string _cachePath;
+	// Construction, and the first compile call
+	std::chrono::steady_clock::time_point _start;
+	std::chrono::steady_clock::time_point _compileStart;
 };
\ No newline at end of file
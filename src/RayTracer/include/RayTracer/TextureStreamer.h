@@ -0,0 +1,144 @@
+#pragma once
+
+#include <RayTracerLib/TextureCompression.hpp>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// OpenGL internal format used to store `format`
+uint32_t TextureInternalFormat(TextureFormat format);
+// BC1 comes from an extension, check every compressed format before using it
+bool IsTextureFormatSupported(TextureFormat format);
+
+struct TextureStreamerCreateInfo {
+	// GPU memory streamed textures may use, the finest levels are evicted above it
+	size_t budgetBytes = 256 * 1024 * 1024;
+	// Most bytes uploaded in one frame, so a burst of loads never makes a frame long
+	size_t uploadBytesPerFrame = 16 * 1024 * 1024;
+	// Textures start with the levels up to this size resident
+	uint32_t initialSize = 64;
+	// Loads are read and uploaded in the update that requests them, whatever they cost, so what
+	// is resident only depends on the frames drawn (benchmarks)
+	bool synchronous = false;
+};
+
+struct TextureStreamerStats {
+	uint32_t textureCount = 0;
+	size_t residentBytes = 0;
+	// What the requested levels would use, before applying the budget
+	size_t requestedBytes = 0;
+	size_t budgetBytes = 0;
+	// Loads queued or waiting to be uploaded
+	uint32_t pendingRequests = 0;
+	size_t uploadedBytes = 0;
+	uint32_t evictions = 0;
+
+	// Above 1 the budget is too small for what is on screen
+	float Pressure() const
+	{
+		return budgetBytes ? (float)requestedBytes / budgetBytes : 0.0f;
+	}
+};
+
+// Owns the OpenGL textures of every model and decides which of their levels are resident.
+// Each frame, draws request the level they need; `Update` then evicts the finest levels of
+// textures that aren't needed anymore (or don't fit the budget) and a background thread reads
+// the missing levels from the texture cache. Changing the levels of a texture means creating a
+// new one (immutable storage can't be resized), the levels that stay are copied on the GPU.
+class TextureStreamer {
+    public:
+	TextureStreamer(const TextureStreamerCreateInfo &info);
+	~TextureStreamer();
+
+	TextureStreamer(const TextureStreamer &) = delete;
+	TextureStreamer &operator=(const TextureStreamer &) = delete;
+
+	// Takes every level of `texture`, only the coarse ones are uploaded when `source` (the
+	// texture's cache file) is given, the others are read from it when needed and only need
+	// their size (see TextureCache::LoadCoarse). Without a source the texture is always fully resident.
+	uint32_t Add(const TextureData &texture, std::filesystem::path source);
+	void Release(uint32_t id);
+
+	// OpenGL handle, it changes when the resident levels do so don't keep it across frames
+	uint32_t Handle(uint32_t id) const;
+	// Textures added with a source start with the levels up to this size
+	uint32_t InitialSize() const;
+	// Largest dimension of level 0, it never changes so it can be read while the streamer updates
+	uint32_t Size(uint32_t id) const;
+	// Asks for `level` to be resident, the finest request of the frame wins
+	void Request(uint32_t id, uint32_t level);
+	// Applies the requests made since the last update, call it before fetching handles
+	void Update();
+
+	void SetBudget(size_t bytes);
+	TextureStreamerStats Stats() const;
+
+    private:
+	struct LevelInfo {
+		uint32_t width;
+		uint32_t height;
+		size_t size;
+	};
+
+	struct Texture {
+		uint32_t handle = 0;
+		TextureFormat format = TextureFormat::RGBA8;
+		std::vector<LevelInfo> levels;
+		std::filesystem::path source;
+		// Finest resident level
+		uint32_t residentLevel = 0;
+		// Coarsest level that must stay resident, what the texture started with
+		uint32_t minimumLevel = 0;
+		// Finest level requested since the last update, `levels.size()` when none
+		uint32_t requestedLevel = 0;
+		// Bumped when the slot is reused, so late loads of released textures are dropped
+		uint32_t generation = 0;
+		bool pending = false;
+		bool used = false;
+	};
+
+	struct LoadRequest {
+		uint32_t id;
+		uint32_t generation;
+		std::filesystem::path source;
+		uint32_t firstLevel;
+		uint32_t count;
+	};
+
+	struct LoadResult {
+		uint32_t id;
+		uint32_t generation;
+		uint32_t firstLevel;
+		bool loaded;
+		TextureData data;
+	};
+
+	void LoaderThread(std::stop_token stopToken);
+	// Replaces the texture with one holding levels [firstLevel, end). Levels finer than the
+	// resident ones come from `data` (whose first level is `dataFirstLevel`), the others are
+	// copied from the current texture.
+	void Reside(Texture &texture, uint32_t firstLevel,
+		    const TextureData *data, uint32_t dataFirstLevel);
+	size_t LevelBytes(const Texture &texture, uint32_t firstLevel) const;
+
+	TextureStreamerCreateInfo _info;
+	std::vector<Texture> _textures;
+	std::vector<uint32_t> _freeIds;
+	// Loads that are done but didn't fit the last frame's upload budget
+	std::deque<LoadResult> _deferred;
+	TextureStreamerStats _stats;
+
+	// Shared with the loader thread
+	std::mutex _mutex;
+	std::condition_variable_any _condition;
+	std::deque<LoadRequest> _requests;
+	std::vector<LoadResult> _results;
+	// Declared last, it must stop before the queues it uses are destroyed
+	std::jthread _loader;
+};
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// A contiguous range of nodes (or of their world matrices)
+struct TransformRange {
+	uint32_t first;
+	uint32_t count;
+};
+
+// Node transforms of a scene graph, stored as one array per component. Nodes are stored depth
+// first, a node comes right before its descendants, so every subtree is a contiguous range and
+// parents are always computed before their children. Update only recomputes what moved.
+class TransformHierarchy {
+    public:
+	static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+	// Parents must be added before their children, and a node's descendants right after it
+	uint32_t Add(uint32_t parent, const glm::vec3 &translation,
+		     const glm::quat &rotation, const glm::vec3 &scale);
+	// Splits the hierarchy into independent subtrees for Update, once every node is added
+	void Build();
+
+	void SetTranslation(uint32_t node, const glm::vec3 &translation);
+	void SetRotation(uint32_t node, const glm::quat &rotation);
+	void SetScale(uint32_t node, const glm::vec3 &scale);
+
+	// Recomputes the world matrices of the nodes whose local transform changed and of their
+	// descendants. Subtrees are spread over every core.
+	void Update();
+
+	uint32_t Size() const;
+	uint32_t Parent(uint32_t node) const;
+	const std::vector<glm::mat4> &WorldMatrices() const;
+	// World matrices changed by the last Update, sorted, everything after Build
+	const std::vector<TransformRange> &DirtyRanges() const;
+
+    private:
+	// Updates the nodes of `range`, whose parents are already up to date
+	void UpdateRange(uint32_t first, uint32_t count);
+
+	std::vector<uint32_t> _parents;
+	// Number of nodes in the subtree of each node, the node included
+	std::vector<uint32_t> _subtreeSizes;
+	std::vector<glm::vec3> _translations;
+	std::vector<glm::quat> _rotations;
+	std::vector<glm::vec3> _scales;
+	std::vector<glm::mat4> _worlds;
+	// Bytes, not vector<bool>, so threads can flag neighbouring nodes at the same time
+	std::vector<uint8_t> _localDirty;
+	std::vector<uint8_t> _worldDirty;
+	// Updated one after the other first, they are the ancestors of the parallel subtrees
+	std::vector<uint32_t> _serialNodes;
+	std::vector<TransformRange> _subtrees;
+	std::vector<TransformRange> _dirtyRanges;
+};
\ No newline at end of file
@@ -0,0 +1,312 @@
+#include <RayTracerBench/Benchmarks.h>
+
+#include <RayTracer/Animation.h>
+#include <RayTracer/DrawList.h>
+#include <RayTracer/MeshProcessing.h>
+#include <RayTracer/ModelImport.h>
+
+#include <spdlog/spdlog.h>
+#include <stb_image.h>
+
+#include <algorithm>
+#include <chrono>
+#include <numbers>
+#include <string_view>
+#include <vector>
+
+// Results are folded into this, so the compiler can't drop the work being timed
+static volatile uint64_t sink = 0;
+
+static void Consume(uint64_t value)
+{
+	sink = sink + value;
+}
+
+// A red and green checker only varies in hue, an encoder that collapses it to one color would
+// produce the same block as for its average color
+static bool CheckBlockEncoders()
+{
+	uint8_t checker[64];
+	uint8_t average[64];
+	for (uint32_t i = 0; i < 16; ++i) {
+		const bool red = ((i & 3) + (i >> 2)) % 2 == 0;
+		checker[i * 4 + 0] = red ? 255 : 0;
+		checker[i * 4 + 1] = red ? 0 : 255;
+		checker[i * 4 + 2] = 0;
+		checker[i * 4 + 3] = 255;
+		average[i * 4 + 0] = 128;
+		average[i * 4 + 1] = 128;
+		average[i * 4 + 2] = 0;
+		average[i * 4 + 3] = 255;
+	}
+	const struct {
+		const char *name;
+		void (*encode)(const uint8_t *, uint8_t *);
+		size_t size;
+	} encoders[] = {
+		{ "BC1", EncodeBlockBC1, 8 },
+		{ "BC5", EncodeBlockBC5, 16 },
+		{ "BC7", EncodeBlockBC7, 16 },
+	};
+	bool valid = true;
+	for (const auto &encoder : encoders) {
+		uint8_t checkerBlock[16] = {};
+		uint8_t averageBlock[16] = {};
+		encoder.encode(checker, checkerBlock);
+		encoder.encode(average, averageBlock);
+		if (std::equal(checkerBlock, checkerBlock + encoder.size,
+			       averageBlock)) {
+			spdlog::error(
+				"Bench: {} encodes a red and green block as a single color",
+				encoder.name);
+			valid = false;
+		}
+	}
+	return valid;
+}
+
+// Runs `function` for the warmup iterations, then times every other run in milliseconds
+template <typename Function>
+static void Measure(BenchmarkReport &report, std::string_view name,
+		    const MicrobenchmarkOptions &options, Function &&function)
+{
+	for (uint32_t i = 0; i < options.warmupIterations; ++i) {
+		function();
+	}
+	std::vector<double> times;
+	for (uint32_t i = 0; i < options.iterations; ++i) {
+		const auto start = std::chrono::steady_clock::now();
+		function();
+		times.emplace_back(std::chrono::duration<double, std::milli>(
+					   std::chrono::steady_clock::now() -
+					   start)
+					   .count());
+		report.Add(i, name, times.back());
+	}
+	spdlog::info("Bench: {:<16} p50 {:9.3f} ms, p90 {:9.3f} ms", name,
+		     Percentile(times, 0.5), Percentile(times, 0.9));
+}
+
+// A tree where every node has up to `BRANCHING` children, stored depth first like imported
+// scenes. Every node spins around its own axis, every fourth one also bobs up and down.
+static void BuildAnimatedHierarchy(uint32_t nodeCount,
+				   TransformHierarchy &hierarchy,
+				   Animation &animation)
+{
+	static constexpr uint32_t BRANCHING = 8;
+	static constexpr uint32_t MAX_DEPTH = 8;
+	animation.name = "bench";
+	animation.duration = 2.0f;
+	// The nodes to add with their parent and depth, the last one is added next
+	std::vector<std::pair<uint32_t, uint32_t> > stack;
+	stack.emplace_back(TransformHierarchy::NO_PARENT, 0);
+	while (!stack.empty() && hierarchy.Size() < nodeCount) {
+		const auto [parent, depth] = stack.back();
+		stack.pop_back();
+		const auto node = hierarchy.Add(
+			parent, glm::vec3(1.0f, 0.0f, 0.0f),
+			glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(0.9f));
+		if (depth < MAX_DEPTH) {
+			for (uint32_t i = 0; i < BRANCHING; ++i) {
+				stack.emplace_back(node, depth + 1);
+			}
+		}
+
+		// Half turns around an axis that depends on the node, x, y, z, w per key
+		const auto axis =
+			glm::normalize(glm::vec3(1.0f, node % 3, node % 5));
+		AnimationChannel rotation{ node, AnimationPath::Rotation,
+					   AnimationInterpolation::Linear };
+		for (uint32_t key = 0; key < 3; ++key) {
+			const auto angle = key * std::numbers::pi_v<float> / 2.0f;
+			const auto q = glm::angleAxis(angle, axis);
+			rotation.times.emplace_back(key * 1.0f);
+			rotation.values.insert(rotation.values.end(),
+					       { q.x, q.y, q.z, q.w });
+		}
+		animation.channels.emplace_back(std::move(rotation));
+		if (node % 4 == 0) {
+			animation.channels.emplace_back(AnimationChannel{
+				node,
+				AnimationPath::Translation,
+				AnimationInterpolation::Linear,
+				{ 0.0f, 1.0f, 2.0f },
+				{ 1.0f, 0.0f, 0.0f, 1.0f, 0.5f, 0.0f, 1.0f,
+				  0.0f, 0.0f },
+			});
+		}
+	}
+	hierarchy.Build();
+	hierarchy.Update();
+}
+
+bool RunMicrobenchmarks(const std::string &scenePath,
+			const MicrobenchmarkOptions &options,
+			BenchmarkReport &report)
+{
+	ModelImportData data;
+	if (!ImportModel(scenePath, data)) {
+		return false;
+	}
+	size_t vertexCount = 0;
+	size_t triangleCount = 0;
+	for (const auto &mesh : data.meshes) {
+		vertexCount += mesh.vertices.size();
+		triangleCount += mesh.indices.size() / 3;
+	}
+	report.SetInfo("scene", scenePath);
+	report.SetInfo("meshes", data.meshes.size());
+	report.SetInfo("vertices", vertexCount);
+	report.SetInfo("triangles", triangleCount);
+	report.SetInfo("textures", data.texturePaths.size());
+	report.SetInfo("iterations", options.iterations);
+	spdlog::info("Bench: {} has {} meshes, {} vertices, {} triangles, {} textures",
+		     scenePath, data.meshes.size(), vertexCount, triangleCount,
+		     data.texturePaths.size());
+
+	// cgltf parsing, buffer loading and conversion to our vertex format
+	Measure(report, "parse", options, [&] {
+		ModelImportData parsed;
+		ImportModel(scenePath, parsed);
+		Consume(parsed.meshes.size());
+	});
+
+	std::vector<CompactVertex> packed;
+	Measure(report, "pack_vertices", options, [&] {
+		for (const auto &mesh : data.meshes) {
+			packed.resize(mesh.vertices.size());
+			for (size_t i = 0; i < mesh.vertices.size(); ++i) {
+				packed[i] = PackVertex(mesh.vertices[i],
+						       mesh.boundsMin,
+						       mesh.boundsMax);
+			}
+			Consume(packed.empty() ? 0 :
+						 packed.back().position[0]);
+		}
+	});
+
+	// Includes copying the meshes, the optimization works in place
+	Measure(report, "optimize_meshes", options, [&] {
+		for (const auto &mesh : data.meshes) {
+			auto vertices = mesh.vertices;
+			auto indices = mesh.indices;
+			MeshletData meshlets;
+			const auto stats = OptimizeMesh(vertices, indices,
+							meshlets, {});
+			Consume(stats.transformedAfter);
+		}
+	});
+
+	Measure(report, "build_lods", options, [&] {
+		for (const auto &mesh : data.meshes) {
+			Consume(BuildLods(mesh.vertices, mesh.indices, {})
+					.size());
+		}
+	});
+
+	// Files are read once, only decoding and mip generation are timed
+	std::vector<std::vector<uint8_t> > files(data.texturePaths.size());
+	for (size_t i = 0; i < files.size(); ++i) {
+		if (!ReadFile(data.texturePaths[i], files[i])) {
+			spdlog::error("Bench: Unable to read {}",
+				      data.texturePaths[i]);
+			return false;
+		}
+	}
+	std::vector<TextureData> decoded(files.size());
+	Measure(report, "texture_decode", options, [&] {
+		for (size_t i = 0; i < files.size(); ++i) {
+			int32_t width = 0;
+			int32_t height = 0;
+			int32_t channels = STBI_rgb_alpha;
+			auto *pixels = stbi_load_from_memory(
+				files[i].data(), files[i].size(), &width,
+				&height, &channels, STBI_rgb_alpha);
+			if (!pixels) {
+				continue;
+			}
+			decoded[i] = BuildMipChain(pixels, width, height);
+			stbi_image_free(pixels);
+		}
+	});
+
+	if (options.textureFormat != TextureFormat::RGBA8) {
+		// Timing an encoder that gets the colors wrong would be meaningless
+		if (!CheckBlockEncoders()) {
+			return false;
+		}
+		Measure(report, "texture_compress", options, [&] {
+			for (const auto &texture : decoded) {
+				if (!texture.levels.empty()) {
+					Consume(CompressTexture(
+							texture,
+							options.textureFormat)
+							.levels.size());
+				}
+			}
+		});
+	}
+
+	// Laid out one after the other like in the geometry pool, texture ids stand in for handles
+	std::vector<Mesh> meshes;
+	size_t vertexOffset = 0;
+	size_t indexOffset = 0;
+	for (auto info : data.meshes) {
+		info.vertexOffset = vertexOffset;
+		info.indexOffset = indexOffset;
+		info.vertexFormat = VertexFormat::Standard;
+		info.vertexStride = sizeof(Vertex);
+		info.indexSize = sizeof(uint32_t);
+		info.meshletCount = 0;
+		vertexOffset += info.vertices.size() * sizeof(Vertex);
+		indexOffset += info.indices.size() * sizeof(uint32_t);
+		meshes.emplace_back(info);
+	}
+	DrawList drawList;
+	DrawBatches batches;
+	// What Scene::Prepare does every frame, without the level of detail selection
+	Measure(report, "batch_build", options, [&] {
+		drawList.objects.clear();
+		drawList.commands.clear();
+		drawList.baseColorTextures.clear();
+		drawList.transformBlocks = { TransformBlock{ &data.transforms,
+							     0, 0 } };
+		drawList.transformCount = data.transforms.Size();
+		for (const auto &mesh : meshes) {
+			drawList.objects.emplace_back(ObjectData{
+				mesh.TransformIndex(),
+				0,
+				0,
+				mesh.Format(),
+				glm::vec4(mesh.PositionOffset(), 0.0f),
+				glm::vec4(mesh.PositionScale(), 0.0f),
+			});
+			drawList.commands.emplace_back(mesh.Info());
+			drawList.baseColorTextures.emplace_back(
+				mesh.BaseColorTexture());
+		}
+		BuildBatches(drawList, batches);
+		Consume(batches.triangles);
+	});
+
+	if (options.animatedNodes > 0) {
+		TransformHierarchy hierarchy;
+		Animation animation;
+		BuildAnimatedHierarchy(options.animatedNodes, hierarchy,
+				       animation);
+		report.SetInfo("animated_nodes", hierarchy.Size());
+		report.SetInfo("animation_channels", animation.channels.size());
+		// What Model::Animate does every frame, one 60 Hz frame later each time
+		uint32_t frame = 0;
+		Measure(report, "animate", options, [&] {
+			SampleAnimation(animation, ++frame / 60.0, hierarchy);
+			hierarchy.Update();
+			Consume(hierarchy.DirtyRanges().size());
+		});
+	}
+
+	// The renderer is a rasterizer, there is no acceleration structure to query yet
+	report.SetInfo("ray_query", "skipped");
+	spdlog::info("Bench: No ray query path in the renderer, skipped");
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,79 @@
+#define CGLTF_IMPLEMENTATION
+#include <cgltf.h>
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#include <RayTracerBench/Benchmarks.h>
+#include <RayTracerBench/SceneGenerator.h>
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <utility>
+
+// Usage: RayTracerBench [--scene <path>] [--generate] [--output <path>] [--iterations N]
+//                       [--animated-nodes N] [generator options]
+// Generator options: --meshes N --triangles N --instances N --depth N --materials N --textures N
+//                    --texture-size N --index-width 8|16|32 --seed N
+// The scene (bench/scene.glb by default) is generated when missing or with --generate, the
+// results are written to <output>.csv and <output>.json (bench/results by default).
+int main(int argc, char *argv[])
+{
+	SceneGeneratorOptions generator;
+	MicrobenchmarkOptions options;
+	std::string scenePath = "bench/scene.glb";
+	std::string outputPath = "bench/results";
+	bool generate = false;
+
+	const std::pair<std::string_view, uint32_t *> numbers[] = {
+		{ "--meshes", &generator.meshCount },
+		{ "--triangles", &generator.trianglesPerMesh },
+		{ "--instances", &generator.instancesPerMesh },
+		{ "--depth", &generator.nodeDepth },
+		{ "--materials", &generator.materialCount },
+		{ "--textures", &generator.textureCount },
+		{ "--texture-size", &generator.textureSize },
+		{ "--index-width", &generator.indexWidth },
+		{ "--seed", &generator.seed },
+		{ "--iterations", &options.iterations },
+		{ "--animated-nodes", &options.animatedNodes },
+	};
+	for (int i = 1; i < argc; ++i) {
+		const std::string_view argument = argv[i];
+		const auto number = std::find_if(
+			std::begin(numbers), std::end(numbers),
+			[&](const auto &entry) { return entry.first == argument; });
+		if (number != std::end(numbers) && i + 1 < argc) {
+			*number->second = std::strtoul(argv[++i], nullptr, 10);
+		} else if (argument == "--scene" && i + 1 < argc) {
+			scenePath = argv[++i];
+		} else if (argument == "--output" && i + 1 < argc) {
+			outputPath = argv[++i];
+		} else if (argument == "--generate") {
+			generate = true;
+		} else {
+			spdlog::error("Unknown option {}", argument);
+			return 1;
+		}
+	}
+
+	if (generate || !std::filesystem::exists(scenePath)) {
+		if (!GenerateScene(scenePath, generator)) {
+			return 1;
+		}
+	}
+
+	BenchmarkReport report;
+	if (!RunMicrobenchmarks(scenePath, options, report) ||
+	    !report.Write(outputPath)) {
+		return 1;
+	}
+	return 0;
+}
\ No newline at end of file
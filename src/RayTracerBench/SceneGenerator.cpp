@@ -0,0 +1,397 @@
+#include <RayTracerBench/SceneGenerator.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <spdlog/spdlog.h>
+#include <stb_image_write.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Side of the square the root nodes are spread over, about what the app's camera orbit sees
+static constexpr float SCENE_EXTENT = 4.0f;
+
+// glTF enums
+static constexpr uint32_t GLTF_FLOAT = 5126;
+static constexpr uint32_t GLTF_ARRAY_BUFFER = 34962;
+static constexpr uint32_t GLTF_ELEMENT_ARRAY_BUFFER = 34963;
+static constexpr uint32_t GLB_MAGIC = 0x46546C67;
+static constexpr uint32_t GLB_CHUNK_JSON = 0x4E4F534A;
+static constexpr uint32_t GLB_CHUNK_BIN = 0x004E4942;
+
+struct GeneratedMesh {
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> normals;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec4> tangents;
+	std::vector<uint32_t> indices;
+};
+
+// A sphere with its radius modulated by a couple of random waves, so no two meshes are alike
+static GeneratedMesh GenerateMesh(uint32_t triangleCount, std::mt19937 &random)
+{
+	const auto segments = std::max<uint32_t>(
+		3, (uint32_t)std::lround(std::sqrt((double)triangleCount)));
+	const auto rings = std::max<uint32_t>(
+		2, (triangleCount + 2 * segments - 1) / (2 * segments));
+	std::uniform_real_distribution<float> amplitude(0.05f, 0.25f);
+	std::uniform_real_distribution<float> phase(0.0f, glm::two_pi<float>());
+	std::uniform_int_distribution<int32_t> frequency(1, 6);
+	const auto waveAmplitude = amplitude(random);
+	const auto thetaFrequency = (float)frequency(random);
+	const auto phiFrequency = (float)frequency(random);
+	const auto thetaPhase = phase(random);
+	const auto phiPhase = phase(random);
+
+	GeneratedMesh mesh;
+	for (uint32_t ring = 0; ring <= rings; ++ring) {
+		const auto theta = glm::pi<float>() * ring / rings;
+		for (uint32_t segment = 0; segment <= segments; ++segment) {
+			const auto phi = glm::two_pi<float>() * segment / segments;
+			const auto radius =
+				1.0f + waveAmplitude *
+					       std::sin(thetaFrequency * theta +
+							thetaPhase) *
+					       std::sin(phiFrequency * phi +
+							phiPhase);
+			mesh.positions.emplace_back(
+				radius * std::sin(theta) * std::cos(phi),
+				radius * std::cos(theta),
+				radius * std::sin(theta) * std::sin(phi));
+			mesh.uvs.emplace_back((float)segment / segments,
+					      (float)ring / rings);
+		}
+	}
+	const auto stride = segments + 1;
+	for (uint32_t ring = 0; ring < rings; ++ring) {
+		for (uint32_t segment = 0; segment < segments; ++segment) {
+			const auto a = ring * stride + segment;
+			const auto b = a + stride;
+			// Counter-clockwise seen from outside
+			mesh.indices.insert(mesh.indices.end(),
+					    { a, a + 1, b, a + 1, b + 1, b });
+		}
+	}
+
+	// Area weighted face normals, the seam and the poles are smooth enough for a benchmark
+	mesh.normals.assign(mesh.positions.size(), glm::vec3(0.0f));
+	for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+		const auto &p0 = mesh.positions[mesh.indices[i]];
+		const auto &p1 = mesh.positions[mesh.indices[i + 1]];
+		const auto &p2 = mesh.positions[mesh.indices[i + 2]];
+		const auto normal = glm::cross(p1 - p0, p2 - p0);
+		for (size_t k = 0; k < 3; ++k) {
+			mesh.normals[mesh.indices[i + k]] += normal;
+		}
+	}
+	for (size_t i = 0; i < mesh.positions.size(); ++i) {
+		auto &normal = mesh.normals[i];
+		const auto length = glm::length(normal);
+		normal = length > 0.0f ? normal / length :
+					 glm::normalize(mesh.positions[i]);
+		// The tangent follows the u direction, around the sphere
+		const auto phi = glm::two_pi<float>() * mesh.uvs[i].x;
+		auto tangent = glm::vec3(-std::sin(phi), 0.0f, std::cos(phi));
+		tangent = glm::normalize(tangent -
+					 normal * glm::dot(normal, tangent));
+		mesh.tangents.emplace_back(tangent, 1.0f);
+	}
+	return mesh;
+}
+
+// Appends `size` bytes as a new buffer view and returns its index, views start 4-byte aligned
+static uint32_t AppendView(std::vector<uint8_t> &buffer, std::string &views,
+			   uint32_t &viewCount, const void *data, size_t size,
+			   uint32_t target)
+{
+	buffer.resize((buffer.size() + 3) & ~(size_t)3);
+	fmt::format_to(
+		std::back_inserter(views),
+		"{}{{ \"buffer\": 0, \"byteOffset\": {}, \"byteLength\": {}, \"target\": {} }}",
+		viewCount ? ",\n\t\t" : "\n\t\t", buffer.size(), size, target);
+	const auto *bytes = (const uint8_t *)data;
+	buffer.insert(buffer.end(), bytes, bytes + size);
+	return viewCount++;
+}
+
+static bool WriteTexture(const fs::path &path, uint32_t index, uint32_t size)
+{
+	// A checkerboard with its own color, so textures don't compress the same
+	const glm::vec3 color(0.5f + 0.5f * std::cos(index * 2.4f),
+			      0.5f + 0.5f * std::cos(index * 2.4f + 2.1f),
+			      0.5f + 0.5f * std::cos(index * 2.4f + 4.2f));
+	const auto cell = std::max<uint32_t>(1, size / 8);
+	std::vector<uint8_t> pixels((size_t)size * size * 4);
+	for (uint32_t y = 0; y < size; ++y) {
+		for (uint32_t x = 0; x < size; ++x) {
+			const bool dark = ((x / cell) + (y / cell)) % 2;
+			const auto shade = dark ? color * 0.4f : color;
+			auto *pixel = &pixels[((size_t)y * size + x) * 4];
+			pixel[0] = (uint8_t)(shade.x * 255.0f);
+			pixel[1] = (uint8_t)(shade.y * 255.0f);
+			pixel[2] = (uint8_t)(shade.z * 255.0f);
+			pixel[3] = 255;
+		}
+	}
+	return stbi_write_png(path.string().c_str(), size, size, 4,
+			      pixels.data(), size * 4);
+}
+
+bool GenerateScene(const fs::path &path, const SceneGeneratorOptions &options)
+{
+	if (options.meshCount == 0 || options.instancesPerMesh == 0 ||
+	    options.nodeDepth == 0 || options.materialCount == 0 ||
+	    options.textureCount == 0 || options.textureSize == 0) {
+		// Our importer expects every material to have a base color texture
+		spdlog::error(
+			"SceneGenerator: Meshes, instances, depth, materials and textures must be at least 1");
+		return false;
+	}
+	uint32_t indexComponent;
+	uint64_t indexLimit;
+	switch (options.indexWidth) {
+	case 8:
+		indexComponent = 5121;
+		indexLimit = 1ull << 8;
+		break;
+	case 16:
+		indexComponent = 5123;
+		indexLimit = 1ull << 16;
+		break;
+	case 32:
+		indexComponent = 5125;
+		indexLimit = 1ull << 32;
+		break;
+	default:
+		spdlog::error("SceneGenerator: Unsupported index width {}",
+			      options.indexWidth);
+		return false;
+	}
+
+	std::error_code error;
+	if (path.has_parent_path()) {
+		fs::create_directories(path.parent_path(), error);
+	}
+	const bool binary = path.extension() == ".glb";
+	const auto stem = path.stem().string();
+
+	std::mt19937 random(options.seed);
+	std::vector<uint8_t> buffer;
+	std::string views;
+	std::string accessors;
+	std::string meshes;
+	uint32_t viewCount = 0;
+	uint32_t accessorCount = 0;
+	uint64_t triangleCount = 0;
+	for (uint32_t m = 0; m < options.meshCount; ++m) {
+		const auto mesh = GenerateMesh(options.trianglesPerMesh, random);
+		// The largest value is primitive restart, glTF doesn't allow it in indices
+		if (mesh.positions.size() >= indexLimit) {
+			spdlog::error(
+				"SceneGenerator: {} vertices don't fit {}-bit indices, use fewer triangles per mesh",
+				mesh.positions.size(), options.indexWidth);
+			return false;
+		}
+		triangleCount += mesh.indices.size() / 3;
+
+		// Attributes are tightly packed, one view each
+		glm::vec3 boundsMin = mesh.positions.front();
+		glm::vec3 boundsMax = mesh.positions.front();
+		for (const auto &position : mesh.positions) {
+			boundsMin = glm::min(boundsMin, position);
+			boundsMax = glm::max(boundsMax, position);
+		}
+		const auto addAttribute = [&](const void *data, size_t size,
+					      size_t count, const char *type,
+					      std::string bounds) {
+			const auto view = AppendView(buffer, views, viewCount,
+						     data, size,
+						     GLTF_ARRAY_BUFFER);
+			fmt::format_to(
+				std::back_inserter(accessors),
+				"{}{{ \"bufferView\": {}, \"componentType\": {}, \"count\": {}, \"type\": \"{}\"{} }}",
+				accessorCount ? ",\n\t\t" : "\n\t\t", view,
+				GLTF_FLOAT, count, type, bounds);
+			return accessorCount++;
+		};
+		const auto count = mesh.positions.size();
+		const auto position = addAttribute(
+			mesh.positions.data(), count * sizeof(glm::vec3), count,
+			"VEC3",
+			fmt::format(", \"min\": [{}, {}, {}], \"max\": [{}, {}, {}]",
+				    boundsMin.x, boundsMin.y, boundsMin.z,
+				    boundsMax.x, boundsMax.y, boundsMax.z));
+		const auto normal = addAttribute(mesh.normals.data(),
+						 count * sizeof(glm::vec3),
+						 count, "VEC3", "");
+		const auto uv = addAttribute(mesh.uvs.data(),
+					     count * sizeof(glm::vec2), count,
+					     "VEC2", "");
+		const auto tangent = addAttribute(mesh.tangents.data(),
+						  count * sizeof(glm::vec4),
+						  count, "VEC4", "");
+
+		// Indices at the requested width
+		std::vector<uint8_t> indexData(mesh.indices.size() *
+					       options.indexWidth / 8);
+		for (size_t i = 0; i < mesh.indices.size(); ++i) {
+			const auto index = mesh.indices[i];
+			if (options.indexWidth == 8) {
+				indexData[i] = (uint8_t)index;
+			} else if (options.indexWidth == 16) {
+				const auto value = (uint16_t)index;
+				std::memcpy(&indexData[i * 2], &value, 2);
+			} else {
+				std::memcpy(&indexData[i * 4], &index, 4);
+			}
+		}
+		const auto indexView = AppendView(buffer, views, viewCount,
+						  indexData.data(),
+						  indexData.size(),
+						  GLTF_ELEMENT_ARRAY_BUFFER);
+		fmt::format_to(
+			std::back_inserter(accessors),
+			",\n\t\t{{ \"bufferView\": {}, \"componentType\": {}, \"count\": {}, \"type\": \"SCALAR\" }}",
+			indexView, indexComponent, mesh.indices.size());
+		const auto indices = accessorCount++;
+
+		fmt::format_to(
+			std::back_inserter(meshes),
+			"{}{{ \"primitives\": [{{ \"attributes\": {{ \"POSITION\": {}, \"NORMAL\": {}, \"TEXCOORD_0\": {}, \"TANGENT\": {} }}, \"indices\": {}, \"material\": {} }}] }}",
+			m ? ",\n\t\t" : "\n\t\t", position, normal, uv, tangent,
+			indices, m % options.materialCount);
+	}
+
+	std::string materials;
+	for (uint32_t m = 0; m < options.materialCount; ++m) {
+		fmt::format_to(
+			std::back_inserter(materials),
+			"{}{{ \"pbrMetallicRoughness\": {{ \"baseColorTexture\": {{ \"index\": {} }} }} }}",
+			m ? ",\n\t\t" : "\n\t\t", m % options.textureCount);
+	}
+	std::string textures;
+	std::string images;
+	for (uint32_t t = 0; t < options.textureCount; ++t) {
+		const auto name = fmt::format("{}_{}.png", stem, t);
+		if (!WriteTexture(path.parent_path() / name, t,
+				  options.textureSize)) {
+			spdlog::error("SceneGenerator: Unable to write {}",
+				      name);
+			return false;
+		}
+		fmt::format_to(std::back_inserter(textures),
+			       "{}{{ \"source\": {}, \"sampler\": 0 }}",
+			       t ? ",\n\t\t" : "\n\t\t", t);
+		fmt::format_to(std::back_inserter(images),
+			       "{}{{ \"uri\": \"{}\" }}",
+			       t ? ",\n\t\t" : "\n\t\t", name);
+	}
+
+	// Nodes form chains of `nodeDepth`, the chains' roots are laid out on a grid.
+	// Every level moves up, turns and shrinks a bit, so transforms really compose.
+	const auto nodeCount = options.meshCount * options.instancesPerMesh;
+	const auto rootCount =
+		(nodeCount + options.nodeDepth - 1) / options.nodeDepth;
+	const auto gridSize =
+		(uint32_t)std::ceil(std::sqrt((double)rootCount));
+	const auto cell = SCENE_EXTENT / gridSize;
+	std::string nodes;
+	std::string roots;
+	for (uint32_t i = 0; i < nodeCount; ++i) {
+		std::string transform;
+		if (i % options.nodeDepth == 0) {
+			const auto root = i / options.nodeDepth;
+			const auto x = ((root % gridSize) + 0.5f) * cell -
+				       SCENE_EXTENT / 2;
+			const auto z = ((root / gridSize) + 0.5f) * cell -
+				       SCENE_EXTENT / 2;
+			const auto scale = cell * 0.35f;
+			transform = fmt::format(
+				"\"translation\": [{}, 0, {}], \"scale\": [{}, {}, {}]",
+				x, z, scale, scale, scale);
+			fmt::format_to(std::back_inserter(roots), "{}{}",
+				       root ? ", " : "", i);
+		} else {
+			const auto angle = 0.4f;
+			transform = fmt::format(
+				"\"translation\": [0, 1.6, 0], \"rotation\": [0, {}, 0, {}], \"scale\": [0.7, 0.7, 0.7]",
+				std::sin(angle / 2), std::cos(angle / 2));
+		}
+		std::string children;
+		if (i + 1 < nodeCount && (i + 1) % options.nodeDepth != 0) {
+			children = fmt::format(", \"children\": [{}]", i + 1);
+		}
+		fmt::format_to(std::back_inserter(nodes),
+			       "{}{{ \"mesh\": {}, {}{} }}",
+			       i ? ",\n\t\t" : "\n\t\t",
+			       i % options.meshCount, transform, children);
+	}
+
+	const auto binName = stem + ".bin";
+	std::string json = fmt::format(
+		"{{\n\t\"asset\": {{ \"version\": \"2.0\", \"generator\": \"RayTracerBench\" }},\n"
+		"\t\"scene\": 0,\n"
+		"\t\"scenes\": [{{ \"nodes\": [{}] }}],\n"
+		"\t\"nodes\": [{}\n\t],\n"
+		"\t\"meshes\": [{}\n\t],\n"
+		"\t\"materials\": [{}\n\t],\n"
+		"\t\"textures\": [{}\n\t],\n"
+		"\t\"images\": [{}\n\t],\n"
+		"\t\"samplers\": [{{}}],\n"
+		"\t\"accessors\": [{}\n\t],\n"
+		"\t\"bufferViews\": [{}\n\t],\n"
+		"\t\"buffers\": [{{ \"byteLength\": {}{} }}]\n}}\n",
+		roots, nodes, meshes, materials, textures, images, accessors,
+		views, buffer.size(),
+		binary ? "" : fmt::format(", \"uri\": \"{}\"", binName));
+
+	std::ofstream file(path, std::ios::binary);
+	if (binary) {
+		// GLB: a header, then the JSON and the binary chunks, both padded to 4 bytes
+		json.resize((json.size() + 3) & ~(size_t)3, ' ');
+		buffer.resize((buffer.size() + 3) & ~(size_t)3, 0);
+		const uint32_t header[] = {
+			GLB_MAGIC, 2,
+			(uint32_t)(12 + 8 + json.size() + 8 + buffer.size())
+		};
+		const uint32_t jsonChunk[] = { (uint32_t)json.size(),
+					       GLB_CHUNK_JSON };
+		const uint32_t binChunk[] = { (uint32_t)buffer.size(),
+					      GLB_CHUNK_BIN };
+		file.write((const char *)header, sizeof(header));
+		file.write((const char *)jsonChunk, sizeof(jsonChunk));
+		file.write(json.data(), json.size());
+		file.write((const char *)binChunk, sizeof(binChunk));
+		file.write((const char *)buffer.data(), buffer.size());
+	} else {
+		file.write(json.data(), json.size());
+		std::ofstream bin(path.parent_path() / binName,
+				  std::ios::binary);
+		bin.write((const char *)buffer.data(), buffer.size());
+		if (!bin) {
+			spdlog::error("SceneGenerator: Unable to write {}",
+				      binName);
+			return false;
+		}
+	}
+	if (error || !file) {
+		spdlog::error("SceneGenerator: Unable to write {}",
+			      path.string());
+		return false;
+	}
+
+	spdlog::info(
+		"SceneGenerator: Wrote {} ({} meshes, {} nodes, {} triangles drawn, {} materials, {} textures)",
+		path.string(), options.meshCount, nodeCount,
+		triangleCount * options.instancesPerMesh, options.materialCount,
+		options.textureCount);
+	return true;
+}
\ No newline at end of file
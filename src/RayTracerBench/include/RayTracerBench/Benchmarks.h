@@ -0,0 +1,25 @@
+#pragma once
+
+#include <RayTracerLib/Benchmark.hpp>
+#include <RayTracerLib/TextureCompression.hpp>
+
+#include <cstdint>
+#include <string>
+
+struct MicrobenchmarkOptions {
+	// Timed runs of every benchmark, each one is a row of the report
+	uint32_t iterations = 10;
+	// Untimed runs first, so caches and allocators are warm
+	uint32_t warmupIterations = 1;
+	TextureFormat textureFormat = TextureFormat::BC7;
+	// Nodes of the procedural hierarchy the animation benchmark samples and updates, 0 skips it
+	uint32_t animatedNodes = 100000;
+};
+
+// Times the CPU side of loading and drawing `scenePath`: parsing, vertex packing, mesh
+// optimization, texture decoding and compression, batch building, and animating a large node
+// hierarchy. Each benchmark adds a series of the same name to `report`. Nothing here needs an
+// OpenGL context.
+bool RunMicrobenchmarks(const std::string &scenePath,
+			const MicrobenchmarkOptions &options,
+			BenchmarkReport &report);
\ No newline at end of file
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+
+struct SceneGeneratorOptions {
+	// Distinct meshes, each one is a deformed sphere with its own shape
+	uint32_t meshCount = 64;
+	uint32_t trianglesPerMesh = 4096;
+	// Nodes referencing each mesh, above 1 the scene instances its meshes
+	uint32_t instancesPerMesh = 1;
+	// Nodes are chained `nodeDepth` deep, every level adds its own transform
+	uint32_t nodeDepth = 1;
+	uint32_t materialCount = 16;
+	// Base color textures, materials use them round robin
+	uint32_t textureCount = 16;
+	uint32_t textureSize = 256;
+	// 8, 16 or 32 bit indices, meshes must have few enough vertices for the width
+	uint32_t indexWidth = 32;
+	// The same seed always produces the same scene
+	uint32_t seed = 1;
+};
+
+// Writes a synthetic glTF scene to `path`, as a GLB when its extension is ".glb", otherwise as a
+// ".gltf" with a separate ".bin". Textures are written next to it as PNG files.
+bool GenerateScene(const std::filesystem::path &path,
+		   const SceneGeneratorOptions &options);
\ No newline at end of file
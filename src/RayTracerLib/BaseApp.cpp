@@ -7,37 +7,154 @@
 #include <imgui_impl_opengl3.h>
 #include <imgui_impl_glfw.h>
 
+#ifdef RAYTRACER_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
 #include <tracy/Tracy.hpp>
 #include <tracy/TracyOpenGL.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
 #include <iostream>
 #include <string>
 
+BaseApp::BaseApp(const BaseAppOptions &options)
+	: _options(options)
+{
+}
+
 void BaseApp::Run()
 {
-	FrameMarkStart("App Run");
 	if (!Initialize()) {
 		return;
 	}
 
 	spdlog::info("App: Initialized");
 
+	// Cold and warm starts differ by what the shader and texture caches already hold
+	const auto loadStart = std::chrono::steady_clock::now();
 	if (!Load()) {
 		return;
 	}
 
-	spdlog::info("App: Loaded");
-
-	double previousTime = glfwGetTime();
-	while (!glfwWindowShouldClose(_windowHandle)) {
-		double currentTime = glfwGetTime();
-		float deltaTime =
-			static_cast<float>(currentTime - previousTime);
-		previousTime = currentTime;
-
-		glfwPollEvents();
+	spdlog::info("App: Loaded in {:.2f} ms",
+		     std::chrono::duration<double, std::milli>(
+			     std::chrono::steady_clock::now() - loadStart)
+			     .count());
+
+	// Recorded every frame, also with a fixed step
+	static const MetricTimer frameTimer("frame.time");
+	static const MetricTimer cpuTimer("frame.cpu");
+	static const MetricCounter frameCounter("frame.count");
+
+	BuildFrameGraph(_frameGraph);
+	auto &jobs = JobSystem::Default();
+	const bool pipelined = _options.maxFramesInFlight > 1;
+
+	const bool benchmark = !_options.benchmarkOutput.empty();
+	_startTime = std::chrono::steady_clock::now();
+	_overlaySnapshot = TakeMetricsSnapshot();
+	_outputSnapshot = _overlaySnapshot;
+	auto previousTime = _startTime;
+	while (!ShouldClose()) {
+		const auto frameStart = std::chrono::steady_clock::now();
+		if (_frameIndex > 0) {
+			frameTimer.Record(std::chrono::duration<double, std::milli>(
+						  frameStart - previousTime)
+						  .count());
+		}
+		float deltaTime;
+		if (_options.fixedDeltaTime > 0.0) {
+			// Same frames every run, however long they take to render
+			deltaTime = static_cast<float>(_options.fixedDeltaTime);
+			_time = _frameIndex * _options.fixedDeltaTime;
+		} else {
+			deltaTime = std::chrono::duration<float>(frameStart -
+								 previousTime)
+					    .count();
+			_time = std::chrono::duration<double>(frameStart -
+							      _startTime)
+					.count();
+		}
+		previousTime = frameStart;
+
+		if (_windowHandle) {
+			ZoneScopedN("Poll events");
+			glfwPollEvents();
+		}
+		TakeInputSnapshot();
+		WaitForFramesInFlight();
+		if (benchmark) {
+			// Also waits for the GPU when it falls more than a few frames behind
+			_gpuTimer->BeginFrame(_frameIndex);
+		}
 		Update(deltaTime);
+		// The first frame, and frames discarded since they were prepared, are prepared right away
+		if (!_framePrepared) {
+			ZoneScopedN("Prepare frame");
+			_preparingFrame = FrameInfo{ _frameIndex, _time, deltaTime };
+			_frameGraph.Run(jobs);
+		}
+		_framePrepared = false;
+		// The next frame is prepared while this one is submitted, from this frame's input
+		const bool lastFrame = _options.frameCount > 0 &&
+				       _frameIndex + 1 >= _options.frameCount;
+		if (pipelined && !lastFrame) {
+			_preparingFrame = FrameInfo{
+				_frameIndex + 1,
+				_options.fixedDeltaTime > 0.0 ?
+					(_frameIndex + 1) * _options.fixedDeltaTime :
+					_time + deltaTime,
+				deltaTime,
+			};
+			_frameGraph.Launch(jobs);
+			_framePrepared = true;
+		}
 		Render(deltaTime);
+
+		const auto cpuMilliseconds =
+			std::chrono::duration<double, std::milli>(
+				std::chrono::steady_clock::now() - frameStart)
+				.count();
+		cpuTimer.Record(cpuMilliseconds);
+		frameCounter.Add();
+		if (benchmark) {
+			_report.Add(_frameIndex, "cpu", cpuMilliseconds);
+			RecordGpuTimes();
+		}
+		UpdateMetrics();
+		++_frameIndex;
+		FrameMark;
+	}
+
+	DiscardPreparedFrame();
+	for (auto *fence : _frameFences) {
+		glDeleteSync((GLsync)fence);
+	}
+	_frameFences.clear();
+
+	if (benchmark) {
+		_gpuTimer->Flush();
+		RecordGpuTimes();
+		_report.SetInfo("renderer",
+				(const char *)glGetString(GL_RENDERER));
+		_report.SetInfo("version", (const char *)glGetString(GL_VERSION));
+		_report.SetInfo("headless", _options.headless ? 1.0 : 0.0);
+		_report.SetInfo("width", GetWidth());
+		_report.SetInfo("height", GetHeight());
+		_report.SetInfo("frames", _frameIndex);
+		_report.SetInfo("fixedDeltaTime", _options.fixedDeltaTime);
+		_report.SetInfo("maxFramesInFlight", _options.maxFramesInFlight);
+		_report.Write(_options.benchmarkOutput);
+	}
+	// The last partial interval too, so short runs still produce a file
+	if (!_options.metricsOutput.empty()) {
+		TakeMetricsSnapshot()
+			.Since(_outputSnapshot)
+			.WriteJson(_options.metricsOutput);
 	}
 
 	spdlog::info("App: Unloading");
@@ -45,20 +162,270 @@ void BaseApp::Run()
 	Unload();
 
 	spdlog::info("App: Unloaded");
-	FrameMarkEnd("App Run");
+}
+
+void BaseApp::RecordGpuTimes()
+{
+	for (const auto &result : _gpuTimer->TakeResults()) {
+		_report.Add(result.frame, "gpu." + result.pass,
+			    result.milliseconds);
+	}
+}
+
+void BaseApp::UpdateMetrics()
+{
+	const auto now = std::chrono::steady_clock::now();
+	// Long enough for the percentiles to mean something, short enough to follow changes
+	if (_uiEnabled &&
+	    now - _overlaySnapshot.time >= std::chrono::milliseconds(500)) {
+		auto snapshot = TakeMetricsSnapshot();
+		_overlayWindow = snapshot.Since(_overlaySnapshot);
+		_overlaySnapshot = std::move(snapshot);
+	}
+	if (!_options.metricsOutput.empty() &&
+	    now - _outputSnapshot.time >=
+		    std::chrono::duration<double>(_options.metricsInterval)) {
+		ZoneScopedN("Write metrics");
+		auto snapshot = TakeMetricsSnapshot();
+		snapshot.Since(_outputSnapshot).WriteJson(_options.metricsOutput);
+		_outputSnapshot = std::move(snapshot);
+	}
+}
+
+void BaseApp::RenderMetrics()
+{
+	ImGui::SetNextWindowSize(ImVec2(480, 360), ImGuiCond_FirstUseEver);
+	if (!ImGui::Begin("Metrics")) {
+		ImGui::End();
+		return;
+	}
+	ImGui::Text("Over the last %.2f s", _overlayWindow.seconds);
+	if (ImGui::BeginTable("Timers", 6,
+			      ImGuiTableFlags_RowBg |
+				      ImGuiTableFlags_SizingStretchProp)) {
+		ImGui::TableSetupColumn("Timer");
+		ImGui::TableSetupColumn("Count");
+		ImGui::TableSetupColumn("Mean ms");
+		ImGui::TableSetupColumn("p50 ms");
+		ImGui::TableSetupColumn("p90 ms");
+		ImGui::TableSetupColumn("p99 ms");
+		ImGui::TableHeadersRow();
+		for (const auto &value : _overlayWindow.values) {
+			if (value.type != MetricType::Timer || value.count == 0) {
+				continue;
+			}
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(value.name.c_str());
+			ImGui::TableNextColumn();
+			ImGui::Text("%" PRIu64, value.count);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", value.MeanMilliseconds());
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", value.PercentileMilliseconds(0.5));
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", value.PercentileMilliseconds(0.9));
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", value.PercentileMilliseconds(0.99));
+		}
+		ImGui::EndTable();
+	}
+	ImGui::Separator();
+	if (ImGui::BeginTable("Values", 3,
+			      ImGuiTableFlags_RowBg |
+				      ImGuiTableFlags_SizingStretchProp)) {
+		ImGui::TableSetupColumn("Metric");
+		ImGui::TableSetupColumn("Value");
+		ImGui::TableSetupColumn("Per second");
+		ImGui::TableHeadersRow();
+		for (const auto &value : _overlayWindow.values) {
+			if (value.type == MetricType::Timer) {
+				continue;
+			}
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(value.name.c_str());
+			ImGui::TableNextColumn();
+			// Memory is easier to read in megabytes
+			if (value.unit == "bytes") {
+				ImGui::Text("%.2f MB", value.value / (1024.0 * 1024.0));
+			} else {
+				ImGui::Text("%" PRId64 " %s", value.value,
+					    value.unit.c_str());
+			}
+			// Counters only, gauges have no rate
+			ImGui::TableNextColumn();
+			if (value.type == MetricType::Counter &&
+			    _overlayWindow.seconds > 0.0) {
+				const auto rate = value.value / _overlayWindow.seconds;
+				if (value.unit == "bytes") {
+					ImGui::Text("%.2f MB", rate / (1024.0 * 1024.0));
+				} else {
+					ImGui::Text("%.1f", rate);
+				}
+			}
+		}
+		ImGui::EndTable();
+	}
+	ImGui::End();
 }
 
 void BaseApp::Close()
 {
-	glfwSetWindowShouldClose(_windowHandle, 1);
+	_closeRequested = true;
+	if (_windowHandle) {
+		glfwSetWindowShouldClose(_windowHandle, 1);
+	}
+}
+
+bool BaseApp::ShouldClose() const
+{
+	if (_options.frameCount > 0 && _frameIndex >= _options.frameCount) {
+		return true;
+	}
+	return _closeRequested ||
+	       (_windowHandle && glfwWindowShouldClose(_windowHandle));
+}
+
+void BaseApp::TakeInputSnapshot()
+{
+	// A hidden window never has the focus
+	if (!_windowHandle || _options.headless) {
+		_input.width = _options.width;
+		_input.height = _options.height;
+		return;
+	}
+	glfwGetFramebufferSize(_windowHandle, &_input.width, &_input.height);
+	for (int32_t key = GLFW_KEY_SPACE; key <= GLFW_KEY_LAST; ++key) {
+		_input.keys[key] = glfwGetKey(_windowHandle, key) == GLFW_PRESS;
+	}
+}
+
+void BaseApp::WaitForFramesInFlight()
+{
+	ZoneScoped;
+	while (_frameFences.size() >= std::max(_options.maxFramesInFlight, 1u)) {
+		const auto fence = (GLsync)_frameFences.front();
+		// Flushed by the swap already, this only blocks
+		while (true) {
+			const GLenum status =
+				glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+						 1000000000);
+			if (status != GL_TIMEOUT_EXPIRED) {
+				break;
+			}
+		}
+		glDeleteSync(fence);
+		_frameFences.pop_front();
+	}
 }
 
 bool BaseApp::IsKeyPressed(int32_t key)
 {
-	return glfwGetKey(_windowHandle, key) == GLFW_PRESS;
+	return key >= 0 && key < KEY_COUNT && _input.keys[key];
 }
 
-bool BaseApp::Initialize()
+double BaseApp::GetTime() const
+{
+	return _time;
+}
+
+uint64_t BaseApp::GetFrameIndex() const
+{
+	return _frameIndex;
+}
+
+int32_t BaseApp::GetWidth() const
+{
+	return _input.width;
+}
+
+int32_t BaseApp::GetHeight() const
+{
+	return _input.height;
+}
+
+const FrameInfo &BaseApp::PreparingFrame() const
+{
+	return _preparingFrame;
+}
+
+void BaseApp::DiscardPreparedFrame()
+{
+	_frameGraph.Wait();
+	_framePrepared = false;
+}
+
+bool BaseApp::IsHeadless() const
+{
+	return _options.headless;
+}
+
+bool BaseApp::InitializeEgl()
+{
+#ifdef RAYTRACER_EGL
+	// Mesa's surfaceless platform needs neither a display server nor a GPU, so llvmpipe works
+	EGLDisplay display = EGL_NO_DISPLAY;
+	const auto getPlatformDisplay =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress(
+			"eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay) {
+		display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+					     nullptr, nullptr);
+	}
+	if (display == EGL_NO_DISPLAY) {
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	}
+	EGLint major, minor;
+	if (display == EGL_NO_DISPLAY ||
+	    !eglInitialize(display, &major, &minor)) {
+		spdlog::warn("EGL: Unable to initialize");
+		return false;
+	}
+
+	const EGLint configAttributes[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+					    EGL_NONE };
+	const EGLint contextAttributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION,
+		4,
+		EGL_CONTEXT_MINOR_VERSION,
+		6,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK,
+		EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE,
+	};
+	EGLConfig config;
+	EGLint configCount = 0;
+	EGLContext context = EGL_NO_CONTEXT;
+	if (eglBindAPI(EGL_OPENGL_API) &&
+	    eglChooseConfig(display, configAttributes, &config, 1,
+			    &configCount) &&
+	    configCount == 1) {
+		context = eglCreateContext(display, config, EGL_NO_CONTEXT,
+					   contextAttributes);
+	}
+	// No surface at all, we render in our own framebuffer
+	if (context == EGL_NO_CONTEXT ||
+	    !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context) ||
+	    !gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) {
+		spdlog::warn("EGL: Unable to create an OpenGL 4.6 context");
+		if (context != EGL_NO_CONTEXT) {
+			eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+				       EGL_NO_CONTEXT);
+			eglDestroyContext(display, context);
+		}
+		eglTerminate(display);
+		return false;
+	}
+	_eglDisplay = display;
+	_eglContext = context;
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool BaseApp::InitializeWindow()
 {
 	if (!glfwInit()) {
 		spdlog::error("Glfw: Unable to initialize");
@@ -72,12 +439,11 @@ bool BaseApp::Initialize()
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 	glfwWindowHint(GLFW_SCALE_TO_MONITOR, GLFW_TRUE);
+	// Headless without EGL, the window only provides the context
+	glfwWindowHint(GLFW_VISIBLE, _options.headless ? GLFW_FALSE : GLFW_TRUE);
 
-	const auto primaryMonitor = glfwGetPrimaryMonitor();
-	const auto primaryMonitorVideoMode = glfwGetVideoMode(primaryMonitor);
-
-	constexpr int windowWidth = 1920;
-	constexpr int windowHeight = 1080;
+	const int windowWidth = _options.width;
+	const int windowHeight = _options.height;
 
 	_windowHandle = glfwCreateWindow(windowWidth, windowHeight,
 					 "RayTracer Template", nullptr,
@@ -88,19 +454,50 @@ bool BaseApp::Initialize()
 		return false;
 	}
 
-	const auto screenWidth = primaryMonitorVideoMode->width;
-	const auto screenHeight = primaryMonitorVideoMode->height;
-	glfwSetWindowPos(_windowHandle, screenWidth / 2 - windowWidth / 2,
-			 screenHeight / 2 - windowHeight / 2);
+	if (!_options.headless) {
+		const auto primaryMonitor = glfwGetPrimaryMonitor();
+		const auto primaryMonitorVideoMode =
+			glfwGetVideoMode(primaryMonitor);
+		const auto screenWidth = primaryMonitorVideoMode->width;
+		const auto screenHeight = primaryMonitorVideoMode->height;
+		glfwSetWindowPos(_windowHandle,
+				 screenWidth / 2 - windowWidth / 2,
+				 screenHeight / 2 - windowHeight / 2);
+	}
 
 	glfwMakeContextCurrent(_windowHandle);
-	gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+		spdlog::error("Glfw: Unable to load OpenGL");
+		return false;
+	}
+	return true;
+}
 
+bool BaseApp::Initialize()
+{
+	ZoneScoped;
+	if (_options.headless && InitializeEgl()) {
+		spdlog::info("App: Rendering headless with EGL");
+	} else if (!InitializeWindow()) {
+		return false;
+	}
+	spdlog::info("App: OpenGL {} on {}",
+		     (const char *)glGetString(GL_VERSION),
+		     (const char *)glGetString(GL_RENDERER));
+	// GPU zones need the context, and the functions glad just loaded
+	TracyGpuContext;
+	TakeInputSnapshot();
+
+	// There is nobody to look at the UI when headless
+	if (_options.headless) {
+		return true;
+	}
 	ImGui::CreateContext();
 	AfterCreatedUiContext();
 	ImGui_ImplGlfw_InitForOpenGL(_windowHandle, true);
 	ImGui_ImplOpenGL3_Init();
 	ImGui::StyleColorsDark();
+	_uiEnabled = true;
 
 	return true;
 }
@@ -121,18 +518,77 @@ bool BaseApp::Load()
 		nullptr);
 	glClearColor(0.05f, 0.02f, 0.07f, 1.0f);
 
-	glfwSwapInterval(1);
+	// Let the driver compile shaders on as many threads as it wants, Shader waits on them only when bound
+	if (GLAD_GL_KHR_parallel_shader_compile) {
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+	}
+
+	if (_options.headless) {
+		// EGL gives us no default framebuffer, a hidden window's may not even be rendered to
+		glCreateRenderbuffers(1, &_colorBuffer);
+		glNamedRenderbufferStorage(_colorBuffer, GL_RGBA8,
+					   _options.width, _options.height);
+		glCreateRenderbuffers(1, &_depthBuffer);
+		glNamedRenderbufferStorage(_depthBuffer, GL_DEPTH_COMPONENT24,
+					   _options.width, _options.height);
+		glCreateFramebuffers(1, &_framebuffer);
+		glNamedFramebufferRenderbuffer(_framebuffer,
+					       GL_COLOR_ATTACHMENT0,
+					       GL_RENDERBUFFER, _colorBuffer);
+		glNamedFramebufferRenderbuffer(_framebuffer,
+					       GL_DEPTH_ATTACHMENT,
+					       GL_RENDERBUFFER, _depthBuffer);
+		if (glCheckNamedFramebufferStatus(_framebuffer,
+						  GL_FRAMEBUFFER) !=
+		    GL_FRAMEBUFFER_COMPLETE) {
+			spdlog::error("App: Unable to create the framebuffer");
+			return false;
+		}
+		// Stays bound, nothing else renders to another framebuffer
+		glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+		glViewport(0, 0, _options.width, _options.height);
+	}
+	_gpuTimer = std::make_unique<GpuTimer>();
+	if (!_options.captureDirectory.empty()) {
+		FrameCaptureOptions capture;
+		capture.directory = _options.captureDirectory;
+		capture.format = _options.captureFormat;
+		capture.blockWhenFull = _options.captureEveryFrame;
+		_capture = std::make_unique<FrameCapture>(capture);
+	}
+
+	if (_windowHandle) {
+		glfwSwapInterval(_options.vsync ? 1 : 0);
+	}
 
 	return true;
 }
 
 void BaseApp::Unload()
 {
-	ImGui_ImplOpenGL3_Shutdown();
-	ImGui_ImplGlfw_Shutdown();
-	BeforeDestroyUiContext();
-	ImGui::DestroyContext();
+	// Waits for the frames still being written
+	_capture.reset();
+	_gpuTimer.reset();
+	glDeleteFramebuffers(1, &_framebuffer);
+	glDeleteRenderbuffers(1, &_colorBuffer);
+	glDeleteRenderbuffers(1, &_depthBuffer);
+
+	if (_uiEnabled) {
+		ImGui_ImplOpenGL3_Shutdown();
+		ImGui_ImplGlfw_Shutdown();
+		BeforeDestroyUiContext();
+		ImGui::DestroyContext();
+	}
 
+#ifdef RAYTRACER_EGL
+	if (_eglDisplay) {
+		eglMakeCurrent(_eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE,
+			       EGL_NO_CONTEXT);
+		eglDestroyContext(_eglDisplay, _eglContext);
+		eglTerminate(_eglDisplay);
+		return;
+	}
+#endif
 	glfwTerminate();
 }
 
@@ -140,18 +596,61 @@ void BaseApp::Render(float dt)
 {
 	ZoneScopedC(tracy::Color::Red2);
 
-	RenderScene(dt);
-	ImGui_ImplOpenGL3_NewFrame();
-	ImGui_ImplGlfw_NewFrame();
-	ImGui::NewFrame();
+	// Time elapsed queries can't be nested, every pass is measured on its own
+	{
+		TracyGpuZone("Scene");
+		_gpuTimer->Begin("Scene");
+		RenderScene(dt);
+		_gpuTimer->End();
+	}
+
+	// Before the UI, the sequence only shows the scene
+	if (_capture) {
+		static const MetricGauge queuedGauge("capture.queued");
+		static const MetricGauge writtenGauge("capture.written");
+		static const MetricGauge droppedGauge("capture.dropped");
+		_capture->Capture(_frameIndex, GetWidth(), GetHeight());
+		const auto stats = _capture->Stats();
+		queuedGauge.Set(stats.queued);
+		writtenGauge.Set(stats.written);
+		droppedGauge.Set(stats.dropped);
+	}
+
+	// The UI may change what the frame graph reads, and the frame's CPU work counts in the frame
 	{
-		RenderUI(dt);
-		ImGui::Render();
-		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-		ImGui::EndFrame();
+		ZoneScopedN("Wait for the frame graph");
+		static const MetricTimer waitTimer("frame.graph_wait");
+		const MetricScope scope(waitTimer);
+		_frameGraph.Wait();
+	}
+
+	if (_uiEnabled) {
+		ZoneScopedN("UI");
+		TracyGpuZone("UI");
+		_gpuTimer->Begin("UI");
+		ImGui_ImplOpenGL3_NewFrame();
+		ImGui_ImplGlfw_NewFrame();
+		ImGui::NewFrame();
+		{
+			RenderUI(dt);
+			RenderMetrics();
+			ImGui::Render();
+			ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+			ImGui::EndFrame();
+		}
+		_gpuTimer->End();
 	}
 
-	glfwSwapBuffers(_windowHandle);
+	if (_options.headless) {
+		// Nothing to present, make sure the GPU gets the frame's commands anyway
+		glFlush();
+	} else {
+		ZoneScopedN("Swap buffers");
+		glfwSwapBuffers(_windowHandle);
+	}
+	_frameFences.emplace_back(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+	// Reads back the GPU zones that are done, a few frames late
+	TracyGpuCollect;
 }
 
 void BaseApp::RenderScene([[maybe_unused]] float dt)
@@ -166,6 +665,10 @@ void BaseApp::Update([[maybe_unused]] float dt)
 {
 }
 
+void BaseApp::BuildFrameGraph([[maybe_unused]] TaskGraph &graph)
+{
+}
+
 void BaseApp::AfterCreatedUiContext()
 {
 }
@@ -0,0 +1,137 @@
+#include <RayTracerLib/Benchmark.hpp>
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <numeric>
+
+double Percentile(std::vector<double> values, double percentile)
+{
+	if (values.empty()) {
+		return 0.0;
+	}
+	std::sort(values.begin(), values.end());
+	const auto rank = std::clamp(percentile, 0.0, 1.0) * (values.size() - 1);
+	const auto lower = (size_t)rank;
+	const auto upper = std::min(lower + 1, values.size() - 1);
+	return values[lower] + (values[upper] - values[lower]) * (rank - lower);
+}
+
+// Enough for renderer names, which may hold quotes
+static std::string JsonString(std::string_view string)
+{
+	std::string result = "\"";
+	for (const auto character : string) {
+		if (character == '"' || character == '\\') {
+			result += '\\';
+		}
+		if ((unsigned char)character >= 0x20) {
+			result += character;
+		}
+	}
+	return result + "\"";
+}
+
+void BenchmarkReport::SetInfo(std::string key, std::string_view value)
+{
+	_info.emplace_back(std::move(key), JsonString(value));
+}
+
+void BenchmarkReport::SetInfo(std::string key, double value)
+{
+	_info.emplace_back(std::move(key), fmt::format("{}", value));
+}
+
+void BenchmarkReport::Add(uint64_t frame, std::string_view series,
+			  double milliseconds)
+{
+	const auto found = std::find(_names.begin(), _names.end(), series);
+	const auto index = (size_t)(found - _names.begin());
+	if (found == _names.end()) {
+		_names.emplace_back(series);
+		_values.emplace_back();
+	}
+	auto &values = _values[index];
+	if (values.size() <= frame) {
+		values.resize(frame + 1,
+			      std::numeric_limits<double>::quiet_NaN());
+	}
+	values[frame] = milliseconds;
+}
+
+bool BenchmarkReport::Write(const std::filesystem::path &path) const
+{
+	std::error_code error;
+	if (path.has_parent_path()) {
+		std::filesystem::create_directories(path.parent_path(), error);
+	}
+
+	auto csvPath = path;
+	csvPath += ".csv";
+	std::ofstream csv(csvPath);
+	csv << "frame";
+	size_t frameCount = 0;
+	for (size_t series = 0; series < _names.size(); ++series) {
+		csv << "," << _names[series] << "_ms";
+		frameCount = std::max(frameCount, _values[series].size());
+	}
+	csv << "\n";
+	for (size_t frame = 0; frame < frameCount; ++frame) {
+		csv << frame;
+		for (const auto &values : _values) {
+			csv << ",";
+			// Missing values stay empty, e.g. GPU times of frames that were never read back
+			if (frame < values.size() && !std::isnan(values[frame])) {
+				csv << fmt::format("{:.4f}", values[frame]);
+			}
+		}
+		csv << "\n";
+	}
+
+	auto jsonPath = path;
+	jsonPath += ".json";
+	std::ofstream json(jsonPath);
+	json << "{\n";
+	for (const auto &[key, value] : _info) {
+		json << "\t" << JsonString(key) << ": " << value << ",\n";
+	}
+	json << "\t\"series\": {";
+	bool first = true;
+	for (size_t series = 0; series < _names.size(); ++series) {
+		std::vector<double> values;
+		std::copy_if(_values[series].begin(), _values[series].end(),
+			     std::back_inserter(values),
+			     [](double value) { return !std::isnan(value); });
+		if (values.empty()) {
+			continue;
+		}
+		const auto [min, max] =
+			std::minmax_element(values.begin(), values.end());
+		const auto mean =
+			std::accumulate(values.begin(), values.end(), 0.0) /
+			values.size();
+		json << (first ? "\n" : ",\n") << "\t\t"
+		     << JsonString(_names[series])
+		     << fmt::format(
+				": {{ \"count\": {}, \"mean\": {:.4f}, \"min\": {:.4f}, \"max\": {:.4f}, \"p50\": {:.4f}, \"p90\": {:.4f}, \"p95\": {:.4f}, \"p99\": {:.4f} }}",
+				values.size(), mean, *min, *max,
+				Percentile(values, 0.5),
+				Percentile(values, 0.9),
+				Percentile(values, 0.95),
+				Percentile(values, 0.99));
+		first = false;
+	}
+	json << "\n\t}\n}\n";
+
+	if (error || !csv || !json) {
+		spdlog::error("Benchmark: Unable to write {}", path.string());
+		return false;
+	}
+	spdlog::info("Benchmark: Wrote {}.csv and {}.json", path.string(),
+		     path.string());
+	return true;
+}
\ No newline at end of file
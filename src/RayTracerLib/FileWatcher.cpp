@@ -0,0 +1,140 @@
+#include <RayTracerLib/FileWatcher.hpp>
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#include <climits>
+#endif
+
+namespace fs = std::filesystem;
+
+fs::path CanonicalPath(const fs::path &path)
+{
+	std::error_code error;
+	auto result = fs::weakly_canonical(path, error);
+	return error ? path.lexically_normal() : result;
+}
+
+#ifdef __linux__
+// Editors either write the file in place (close after write) or write a
+// temporary file and rename it over the original (moved to)
+static constexpr uint32_t WATCH_MASK =
+	IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ONLYDIR;
+
+FileWatcher::FileWatcher()
+{
+	_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (_fd < 0) {
+		spdlog::error("FileWatcher: Unable to initialize inotify");
+	}
+}
+
+FileWatcher::~FileWatcher()
+{
+	if (_fd >= 0) {
+		close(_fd);
+	}
+}
+
+bool FileWatcher::WatchOne(const fs::path &directory)
+{
+	const auto descriptor =
+		inotify_add_watch(_fd, directory.c_str(), WATCH_MASK);
+	if (descriptor < 0) {
+		spdlog::error("FileWatcher: Unable to watch {}",
+			      directory.string());
+		return false;
+	}
+	_directories[descriptor] = directory;
+	return true;
+}
+
+bool FileWatcher::Watch(const fs::path &directory)
+{
+	std::error_code error;
+	const auto canonical = CanonicalPath(directory);
+	if (_fd < 0 || !fs::is_directory(canonical, error)) {
+		return false;
+	}
+	// inotify isn't recursive, every subdirectory needs its own watch
+	bool result = WatchOne(canonical);
+	for (const auto &entry :
+	     fs::recursive_directory_iterator(canonical, error)) {
+		if (entry.is_directory()) {
+			result &= WatchOne(entry.path());
+		}
+	}
+	return result;
+}
+
+std::vector<FileChange> FileWatcher::Poll()
+{
+	std::vector<FileChange> changes;
+	if (_fd < 0) {
+		return changes;
+	}
+	const auto now = std::chrono::steady_clock::now();
+	alignas(inotify_event) char buffer[16 * (sizeof(inotify_event) +
+						 NAME_MAX + 1)];
+	while (true) {
+		const auto length = read(_fd, buffer, sizeof(buffer));
+		// EAGAIN, there is nothing left to read
+		if (length <= 0) {
+			break;
+		}
+		for (ssize_t offset = 0; offset < length;) {
+			const auto *event = (const inotify_event *)(buffer + offset);
+			offset += sizeof(inotify_event) + event->len;
+			const auto directory = _directories.find(event->wd);
+			if (directory == _directories.end() || event->len == 0) {
+				continue;
+			}
+			const auto path = directory->second / event->name;
+			if (event->mask & IN_ISDIR) {
+				// New subdirectories are watched as well
+				if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+					Watch(path);
+				}
+				continue;
+			}
+			// Creating a file is followed by writing it, we report the write
+			if (event->mask & IN_CREATE) {
+				continue;
+			}
+			const bool known =
+				std::any_of(changes.begin(), changes.end(),
+					    [&](const FileChange &change) {
+						    return change.path == path;
+					    });
+			if (!known) {
+				changes.emplace_back(FileChange{ path, now });
+			}
+		}
+	}
+	return changes;
+}
+#else
+FileWatcher::FileWatcher() = default;
+
+FileWatcher::~FileWatcher() = default;
+
+bool FileWatcher::WatchOne([[maybe_unused]] const fs::path &directory)
+{
+	return false;
+}
+
+bool FileWatcher::Watch([[maybe_unused]] const fs::path &directory)
+{
+	return false;
+}
+
+std::vector<FileChange> FileWatcher::Poll()
+{
+	return {};
+}
+#endif
\ No newline at end of file
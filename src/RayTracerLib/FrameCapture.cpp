@@ -0,0 +1,383 @@
+#include <RayTracerLib/FrameCapture.hpp>
+
+#include <glad/glad.h>
+#include <spdlog/spdlog.h>
+#include <tracy/Tracy.hpp>
+
+// A private copy, so the executables using us don't have to provide the implementation
+#define STB_IMAGE_WRITE_STATIC
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+// Encoding a frame takes longer than rendering one, but more writers would take cores from the
+// frame graph, and a full queue drops or waits for frames anyway
+static constexpr uint32_t DEFAULT_WORKER_COUNT = 2;
+
+// Rows are flipped on the way, OpenGL returns the bottom row first
+static bool WritePng(const std::filesystem::path &path, int32_t width,
+		     int32_t height, const std::vector<uint8_t> &pixels)
+{
+	// Alpha is whatever the shaders left there, it isn't meant to be seen
+	std::vector<uint8_t> rgb((size_t)width * height * 3);
+	for (int32_t y = 0; y < height; ++y) {
+		const auto *source = &pixels[(size_t)(height - 1 - y) * width * 4];
+		auto *destination = &rgb[(size_t)y * width * 3];
+		for (int32_t x = 0; x < width; ++x) {
+			destination[x * 3 + 0] = source[x * 4 + 0];
+			destination[x * 3 + 1] = source[x * 4 + 1];
+			destination[x * 3 + 2] = source[x * 4 + 2];
+		}
+	}
+	return stbi_write_png(path.string().c_str(), width, height, 3,
+			      rgb.data(), width * 3) != 0;
+}
+
+// Rounds to nearest, the values we convert are never negative, infinite or NaN
+static uint16_t ToHalf(float value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	const auto exponent = (int32_t)((bits >> 23) & 0xFF) - 127 + 15;
+	const auto mantissa = bits & 0x7FFFFF;
+	if (exponent >= 31) {
+		return 0x7C00;
+	}
+	if (exponent <= 0) {
+		// Denormals, everything below the smallest one is 0
+		if (exponent < -10) {
+			return 0;
+		}
+		return (uint16_t)((mantissa | 0x800000) >> (14 - exponent));
+	}
+	// A carry out of the mantissa correctly bumps the exponent
+	return (uint16_t)(((exponent << 10) | (mantissa >> 13)) +
+			  ((mantissa >> 12) & 1));
+}
+
+// Linear half float for every sRGB encoded byte
+static const std::array<uint16_t, 256> &SrgbToHalf()
+{
+	static const auto table = [] {
+		std::array<uint16_t, 256> table;
+		for (uint32_t i = 0; i < 256; ++i) {
+			const auto value = i / 255.0f;
+			table[i] = ToHalf(value <= 0.04045f ?
+						  value / 12.92f :
+						  std::pow((value + 0.055f) / 1.055f,
+							   2.4f));
+		}
+		return table;
+	}();
+	return table;
+}
+
+template <typename T>
+static void Append(std::vector<uint8_t> &data, const T &value)
+{
+	const auto *bytes = (const uint8_t *)&value;
+	data.insert(data.end(), bytes, bytes + sizeof(T));
+}
+
+static void AppendString(std::vector<uint8_t> &data, std::string_view string)
+{
+	data.insert(data.end(), string.begin(), string.end());
+	data.emplace_back(0);
+}
+
+// Header attributes are a name, a type, the size of the value and the value
+template <typename T>
+static void AppendAttribute(std::vector<uint8_t> &data, std::string_view name,
+			    std::string_view type, const T &value)
+{
+	AppendString(data, name);
+	AppendString(data, type);
+	Append(data, (int32_t)sizeof(T));
+	Append(data, value);
+}
+
+// The smallest valid OpenEXR file: scanlines, no compression, half float B, G and R channels.
+// Everything is little endian, like the machines we run on.
+static bool WriteExr(const std::filesystem::path &path, int32_t width,
+		     int32_t height, const std::vector<uint8_t> &pixels)
+{
+	const auto &toHalf = SrgbToHalf();
+	std::vector<uint8_t> data;
+	// Magic number and version 2, single part scanline file
+	Append(data, (uint32_t)20000630);
+	Append(data, (uint32_t)2);
+
+	// Channels are sorted by name, each one is HALF (1), not linear, sampled at every pixel
+	std::vector<uint8_t> channels;
+	for (const auto *name : { "B", "G", "R" }) {
+		AppendString(channels, name);
+		Append(channels, (int32_t)1);
+		Append(channels, (uint32_t)0);
+		Append(channels, (int32_t)1);
+		Append(channels, (int32_t)1);
+	}
+	channels.emplace_back(0);
+	AppendString(data, "channels");
+	AppendString(data, "chlist");
+	Append(data, (int32_t)channels.size());
+	data.insert(data.end(), channels.begin(), channels.end());
+
+	const std::array<int32_t, 4> window = { 0, 0, width - 1, height - 1 };
+	AppendAttribute(data, "compression", "compression", (uint8_t)0);
+	AppendAttribute(data, "dataWindow", "box2i", window);
+	AppendAttribute(data, "displayWindow", "box2i", window);
+	AppendAttribute(data, "lineOrder", "lineOrder", (uint8_t)0);
+	AppendAttribute(data, "pixelAspectRatio", "float", 1.0f);
+	AppendAttribute(data, "screenWindowCenter", "v2f",
+			std::array<float, 2>{ 0.0f, 0.0f });
+	AppendAttribute(data, "screenWindowWidth", "float", 1.0f);
+	data.emplace_back(0);
+
+	// One scanline per chunk, the offset table comes first
+	const auto lineBytes = (int32_t)(width * 3 * sizeof(uint16_t));
+	auto offset = (uint64_t)(data.size() + height * sizeof(uint64_t));
+	for (int32_t y = 0; y < height; ++y) {
+		Append(data, offset);
+		offset += 2 * sizeof(int32_t) + lineBytes;
+	}
+	data.reserve(offset);
+	for (int32_t y = 0; y < height; ++y) {
+		Append(data, y);
+		Append(data, lineBytes);
+		const auto *source = &pixels[(size_t)(height - 1 - y) * width * 4];
+		// Each channel's whole line, then the next channel
+		for (const auto channel : { 2, 1, 0 }) {
+			for (int32_t x = 0; x < width; ++x) {
+				Append(data, toHalf[source[x * 4 + channel]]);
+			}
+		}
+	}
+
+	std::ofstream file(path, std::ios::binary);
+	file.write((const char *)data.data(), data.size());
+	return (bool)file;
+}
+
+FrameCapture::FrameCapture(const FrameCaptureOptions &options)
+	: _options(options)
+{
+	_options.maxQueuedFrames = std::max(_options.maxQueuedFrames, 1u);
+	std::error_code error;
+	std::filesystem::create_directories(_options.directory, error);
+	if (error) {
+		spdlog::error("FrameCapture: Unable to create {}: {}",
+			      _options.directory.string(), error.message());
+	}
+
+	auto workerCount = _options.workerCount;
+	if (workerCount == 0) {
+		workerCount = DEFAULT_WORKER_COUNT;
+	}
+	for (uint32_t i = 0; i < workerCount; ++i) {
+		_workers.emplace_back([this](std::stop_token stopToken) {
+			WorkerThread(stopToken);
+		});
+	}
+}
+
+FrameCapture::~FrameCapture()
+{
+	Flush();
+	// Deleting the buffers unmaps them
+	for (auto &slot : _slots) {
+		glDeleteBuffers(1, &slot.buffer);
+	}
+	const auto stats = Stats();
+	spdlog::info(
+		"FrameCapture: Wrote {} of {} frames to {}, {} dropped, {} failed",
+		stats.written, stats.captured, _options.directory.string(),
+		stats.dropped, stats.failed);
+}
+
+void FrameCapture::WorkerThread(std::stop_token stopToken)
+{
+#ifdef TRACY_ENABLE
+	tracy::SetThreadName("Frame writer");
+#endif
+	while (true) {
+		Job job;
+		{
+			std::unique_lock lock(_mutex);
+			if (!_jobAdded.wait(lock, stopToken,
+					    [&] { return !_jobs.empty(); })) {
+				return;
+			}
+			job = std::move(_jobs.front());
+			_jobs.pop_front();
+		}
+		const bool written = Write(job);
+		{
+			std::lock_guard lock(_mutex);
+			if (written) {
+				++_stats.written;
+			} else {
+				++_stats.failed;
+			}
+			--_outstanding;
+		}
+		_jobDone.notify_all();
+	}
+}
+
+bool FrameCapture::Write(const Job &job) const
+{
+	ZoneScopedN("FrameCapture: Write");
+	const bool png = _options.format == CaptureFormat::PNG;
+	const auto path =
+		_options.directory / fmt::format("frame_{:06}.{}", job.frame,
+						 png ? "png" : "exr");
+	const bool written =
+		png ? WritePng(path, job.width, job.height, job.pixels) :
+		      WriteExr(path, job.width, job.height, job.pixels);
+	if (!written) {
+		spdlog::error("FrameCapture: Unable to write {}", path.string());
+	}
+	return written;
+}
+
+bool FrameCapture::Collect(Slot &slot, bool wait)
+{
+	// Flushing makes sure the fence reaches the GPU, otherwise waiting on it could never end
+	const auto fence = (GLsync)slot.fence;
+	const GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+					     wait ? UINT64_MAX : 0);
+	if (status == GL_TIMEOUT_EXPIRED) {
+		return false;
+	}
+	glDeleteSync(fence);
+	slot.fence = nullptr;
+	if (status == GL_WAIT_FAILED) {
+		spdlog::error("FrameCapture: Unable to read back frame {}",
+			      slot.frame);
+		std::lock_guard lock(_mutex);
+		++_stats.failed;
+		--_outstanding;
+		_jobDone.notify_all();
+		return true;
+	}
+
+	// The buffer is reused a few frames from now, the workers get their own copy
+	Job job = { slot.frame, slot.width, slot.height, {} };
+	{
+		ZoneScopedN("FrameCapture: Copy");
+		job.pixels.assign(slot.pixels, slot.pixels + slot.size);
+	}
+	{
+		std::lock_guard lock(_mutex);
+		_jobs.emplace_back(std::move(job));
+	}
+	_jobAdded.notify_one();
+	return true;
+}
+
+bool FrameCapture::Reserve()
+{
+	std::unique_lock lock(_mutex);
+	if (_outstanding < _options.maxQueuedFrames) {
+		++_outstanding;
+		return true;
+	}
+	if (!_options.blockWhenFull) {
+		++_stats.dropped;
+		return false;
+	}
+	// Pixel buffers only move on when we collect them, the workers can only free up the frames
+	// they already have
+	lock.unlock();
+	for (uint32_t i = 0; i < RING_SIZE; ++i) {
+		auto &slot = _slots[(_nextSlot + i) % RING_SIZE];
+		if (slot.fence) {
+			Collect(slot, true);
+		}
+	}
+	lock.lock();
+	_jobDone.wait(lock,
+		      [&] { return _outstanding < _options.maxQueuedFrames; });
+	++_outstanding;
+	return true;
+}
+
+void FrameCapture::Capture(uint64_t frame, int32_t width, int32_t height)
+{
+	ZoneScoped;
+	Poll();
+	// A minimized window has no pixels, and an empty buffer can't be mapped
+	if (width <= 0 || height <= 0) {
+		return;
+	}
+	auto &slot = _slots[_nextSlot];
+	// Only happens when the GPU is a whole ring behind
+	if (slot.fence) {
+		Collect(slot, true);
+	}
+	if (!Reserve()) {
+		return;
+	}
+
+	const auto size = (size_t)width * height * 4;
+	if (slot.size != size) {
+		glDeleteBuffers(1, &slot.buffer);
+		// Mapped for as long as the buffer lives, coherent so a signaled fence is all we need
+		const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT |
+					 GL_MAP_COHERENT_BIT;
+		glCreateBuffers(1, &slot.buffer);
+		glNamedBufferStorage(slot.buffer, size, nullptr, flags);
+		slot.pixels = (const uint8_t *)glMapNamedBufferRange(
+			slot.buffer, 0, size, flags);
+		slot.size = size;
+	}
+	// With a pack buffer bound, glReadPixels only schedules the copy
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	slot.frame = frame;
+	slot.width = width;
+	slot.height = height;
+	_nextSlot = (_nextSlot + 1) % RING_SIZE;
+
+	std::lock_guard lock(_mutex);
+	++_stats.captured;
+}
+
+void FrameCapture::Poll()
+{
+	// Oldest first, frames are queued in order and a newer copy can't be done before an older one
+	for (uint32_t i = 0; i < RING_SIZE; ++i) {
+		auto &slot = _slots[(_nextSlot + i) % RING_SIZE];
+		if (slot.fence && !Collect(slot, false)) {
+			return;
+		}
+	}
+}
+
+void FrameCapture::Flush()
+{
+	ZoneScoped;
+	for (uint32_t i = 0; i < RING_SIZE; ++i) {
+		auto &slot = _slots[(_nextSlot + i) % RING_SIZE];
+		if (slot.fence) {
+			Collect(slot, true);
+		}
+	}
+	std::unique_lock lock(_mutex);
+	_jobDone.wait(lock, [&] { return _outstanding == 0; });
+}
+
+FrameCaptureStats FrameCapture::Stats()
+{
+	std::lock_guard lock(_mutex);
+	auto stats = _stats;
+	stats.queued = _outstanding;
+	return stats;
+}
\ No newline at end of file
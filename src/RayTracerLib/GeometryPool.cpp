@@ -0,0 +1,142 @@
+#include <RayTracerLib/GeometryPool.hpp>
+
+#include <glad/glad.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+
+GeometryPool::GeometryPool(const GeometryPoolCreateInfo &info)
+	: _info(info)
+	, _vertexAllocator(info.vertexCapacity)
+	, _indexAllocator(info.indexCapacity)
+{
+	glCreateVertexArrays(1, &_vao);
+	glCreateBuffers(1, &_vbo);
+	glCreateBuffers(1, &_ibo);
+	glNamedBufferStorage(_vbo,
+			     (size_t)_info.vertexCapacity * _info.vertexStride,
+			     nullptr, GL_DYNAMIC_STORAGE_BIT);
+	glNamedBufferStorage(_ibo,
+			     (size_t)_info.indexCapacity * _info.indexSize,
+			     nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+	glVertexArrayVertexBuffer(_vao, 0, _vbo, 0, _info.vertexStride);
+	glVertexArrayElementBuffer(_vao, _ibo);
+	for (const auto &attribute : _info.attributes) {
+		glEnableVertexArrayAttrib(_vao, attribute.location);
+		glVertexArrayAttribFormat(_vao, attribute.location,
+					  attribute.components, attribute.type,
+					  attribute.normalized, attribute.offset);
+		glVertexArrayAttribBinding(_vao, attribute.location, 0);
+	}
+}
+
+GeometryPool::~GeometryPool()
+{
+	glDeleteBuffers(1, &_ibo);
+	glDeleteBuffers(1, &_vbo);
+	glDeleteVertexArrays(1, &_vao);
+}
+
+RangeAllocation GeometryPool::AllocateVertices(uint32_t count)
+{
+	auto allocation = _vertexAllocator.Allocate(count);
+	while (!allocation) {
+		// Double the capacity until the allocation fits, so growing stays rare
+		const auto oldCapacity = _info.vertexCapacity;
+		_info.vertexCapacity =
+			std::max(oldCapacity * 2, oldCapacity + count);
+		GrowBuffer(_vbo, (size_t)oldCapacity * _info.vertexStride,
+			   (size_t)_info.vertexCapacity * _info.vertexStride);
+		glVertexArrayVertexBuffer(_vao, 0, _vbo, 0, _info.vertexStride);
+		_vertexAllocator.Grow(_info.vertexCapacity);
+		allocation = _vertexAllocator.Allocate(count);
+	}
+	return *allocation;
+}
+
+RangeAllocation GeometryPool::AllocateIndices(uint32_t count)
+{
+	auto allocation = _indexAllocator.Allocate(count);
+	while (!allocation) {
+		const auto oldCapacity = _info.indexCapacity;
+		_info.indexCapacity =
+			std::max(oldCapacity * 2, oldCapacity + count);
+		GrowBuffer(_ibo, (size_t)oldCapacity * _info.indexSize,
+			   (size_t)_info.indexCapacity * _info.indexSize);
+		glVertexArrayElementBuffer(_vao, _ibo);
+		_indexAllocator.Grow(_info.indexCapacity);
+		allocation = _indexAllocator.Allocate(count);
+	}
+	return *allocation;
+}
+
+void GeometryPool::FreeVertices(const RangeAllocation &allocation)
+{
+	_vertexAllocator.Free(allocation);
+}
+
+void GeometryPool::FreeIndices(const RangeAllocation &allocation)
+{
+	_indexAllocator.Free(allocation);
+}
+
+void GeometryPool::UploadVertices(const RangeAllocation &allocation,
+				  uint32_t offset, const void *data,
+				  size_t bytes)
+{
+	glNamedBufferSubData(
+		_vbo, ((size_t)allocation.offset + offset) * _info.vertexStride,
+		bytes, data);
+}
+
+void GeometryPool::UploadIndices(const RangeAllocation &allocation,
+				 uint32_t offset, const void *data, size_t bytes)
+{
+	glNamedBufferSubData(
+		_ibo, ((size_t)allocation.offset + offset) * _info.indexSize,
+		bytes, data);
+}
+
+void GeometryPool::Bind() const
+{
+	glBindVertexArray(_vao);
+}
+
+uint32_t GeometryPool::VertexStride() const
+{
+	return _info.vertexStride;
+}
+
+uint32_t GeometryPool::IndexSize() const
+{
+	return _info.indexSize;
+}
+
+uint32_t GeometryPool::IndexType() const
+{
+	return _info.indexSize == sizeof(uint16_t) ? GL_UNSIGNED_SHORT :
+						     GL_UNSIGNED_INT;
+}
+
+GeometryPoolStats GeometryPool::Stats() const
+{
+	return { _vertexAllocator.Stats(), _indexAllocator.Stats(),
+		 _info.vertexStride, _info.indexSize, _growCount };
+}
+
+void GeometryPool::GrowBuffer(uint32_t &buffer, size_t oldBytes,
+			      size_t newBytes)
+{
+	uint32_t newBuffer;
+	glCreateBuffers(1, &newBuffer);
+	glNamedBufferStorage(newBuffer, newBytes, nullptr,
+			     GL_DYNAMIC_STORAGE_BIT);
+	// The copy happens on the GPU, nothing comes back to the CPU
+	glCopyNamedBufferSubData(buffer, newBuffer, 0, 0, oldBytes);
+	glDeleteBuffers(1, &buffer);
+	buffer = newBuffer;
+	_growCount++;
+	spdlog::info("GeometryPool: Grew a buffer from {} to {} bytes",
+		     oldBytes, newBytes);
+}
@@ -0,0 +1,80 @@
+#include <RayTracerLib/GpuTimer.hpp>
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <utility>
+
+GpuTimer::~GpuTimer()
+{
+	for (auto &frame : _frames) {
+		glDeleteQueries(frame.handles.size(), frame.handles.data());
+	}
+}
+
+void GpuTimer::ReadBack(Frame &frame)
+{
+	for (const auto &query : frame.queries) {
+		// Waits if the GPU is more than FRAMES_IN_FLIGHT frames behind, which it shouldn't be
+		uint64_t nanoseconds = 0;
+		glGetQueryObjectui64v(query.handle, GL_QUERY_RESULT,
+				      &nanoseconds);
+		_results.emplace_back(GpuTimerResult{
+			frame.frame, _passes[query.pass], nanoseconds / 1e6 });
+	}
+	frame.queries.clear();
+}
+
+void GpuTimer::BeginFrame(uint64_t frame)
+{
+	_current = &_frames[frame % FRAMES_IN_FLIGHT];
+	ReadBack(*_current);
+	_current->frame = frame;
+}
+
+void GpuTimer::Begin(std::string_view pass)
+{
+	if (!_current) {
+		return;
+	}
+	const auto found = std::find(_passes.begin(), _passes.end(), pass);
+	const auto passIndex = (uint32_t)(found - _passes.begin());
+	if (found == _passes.end()) {
+		_passes.emplace_back(pass);
+	}
+	// The ring only allocates queries for the most passes a frame had
+	auto &frame = *_current;
+	if (frame.queries.size() == frame.handles.size()) {
+		uint32_t handle;
+		glCreateQueries(GL_TIME_ELAPSED, 1, &handle);
+		frame.handles.emplace_back(handle);
+	}
+	const auto handle = frame.handles[frame.queries.size()];
+	frame.queries.emplace_back(Query{ handle, passIndex });
+	glBeginQuery(GL_TIME_ELAPSED, handle);
+}
+
+void GpuTimer::End()
+{
+	if (_current) {
+		glEndQuery(GL_TIME_ELAPSED);
+	}
+}
+
+void GpuTimer::Flush()
+{
+	if (!_current) {
+		return;
+	}
+	// Oldest first, so results stay in frame order
+	const auto last = _current->frame;
+	for (uint64_t frame = last + 1; frame <= last + FRAMES_IN_FLIGHT;
+	     ++frame) {
+		ReadBack(_frames[frame % FRAMES_IN_FLIGHT]);
+	}
+}
+
+std::vector<GpuTimerResult> GpuTimer::TakeResults()
+{
+	return std::exchange(_results, {});
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+#include <RayTracerLib/Hash.hpp>
+
+#include <cstring>
+
+// FNV-1a constants, the data is consumed 8 bytes at a time with an extra
+// multiply-xorshift round so every input bit affects the whole result
+static constexpr uint64_t OFFSET_BASIS = 0xcbf29ce484222325ull;
+static constexpr uint64_t PRIME = 0x100000001b3ull;
+static constexpr uint64_t MIX = 0x9e3779b97f4a7c15ull;
+
+static uint64_t Mix(uint64_t value)
+{
+	value ^= value >> 33;
+	value *= MIX;
+	value ^= value >> 29;
+	return value;
+}
+
+uint64_t HashBytes(const void *data, size_t size, uint64_t seed)
+{
+	const auto *bytes = (const uint8_t *)data;
+	uint64_t hash = OFFSET_BASIS ^ Mix(seed + size);
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		uint64_t word;
+		std::memcpy(&word, bytes + i, sizeof(word));
+		hash = (hash ^ Mix(word)) * PRIME;
+	}
+	for (; i < size; ++i) {
+		hash = (hash ^ bytes[i]) * PRIME;
+	}
+	return Mix(hash);
+}
+
+uint64_t HashString(std::string_view string, uint64_t seed)
+{
+	return HashBytes(string.data(), string.size(), seed);
+}
+
+uint64_t HashCombine(uint64_t hash, uint64_t value)
+{
+	return Mix(hash ^ (Mix(value) + MIX + (hash << 6) + (hash >> 2)));
+}
@@ -0,0 +1,225 @@
+#include <RayTracerLib/JobSystem.hpp>
+
+#include <RayTracerLib/Metrics.hpp>
+
+#include <tracy/Tracy.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <optional>
+#include <string>
+
+// The job system and queue of the worker running on this thread, other threads have none
+struct WorkerContext {
+	const JobSystem *system;
+	uint32_t queue;
+};
+
+static thread_local WorkerContext currentWorker = { nullptr, 0 };
+
+bool JobCounter::IsDone() const
+{
+	return _pending.load(std::memory_order_acquire) == 0 &&
+	       _notifying.load(std::memory_order_acquire) == 0;
+}
+
+JobSystem::JobSystem(const JobSystemOptions &options)
+{
+	auto workerCount = options.workerCount;
+	if (workerCount == 0) {
+		workerCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+	}
+	for (uint32_t i = 0; i < workerCount + 1; ++i) {
+		_queues.emplace_back(std::make_unique<Queue>());
+	}
+	for (uint32_t i = 0; i < workerCount; ++i) {
+		_workers.emplace_back([this, i](std::stop_token stopToken) {
+			WorkerThread(stopToken, i);
+		});
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	while (TryRun(_queues.size() - 1)) {
+	}
+	for (auto &worker : _workers) {
+		worker.request_stop();
+	}
+}
+
+void JobSystem::Submit(const char *name, std::function<void()> job,
+		       JobCounter &counter)
+{
+	counter._pending.fetch_add(1, std::memory_order_relaxed);
+	// Workers keep their jobs, the others share the last queue
+	const auto queue = currentWorker.system == this ?
+				   currentWorker.queue :
+				   (uint32_t)_queues.size() - 1;
+	{
+		std::lock_guard lock(_queues[queue]->mutex);
+		_queues[queue]->jobs.emplace_back(
+			Job{ name, std::move(job), &counter });
+	}
+	_queuedJobs.fetch_add(1, std::memory_order_release);
+	// Taking the lock makes sure a worker about to sleep sees the job or gets the notification
+	{
+		std::lock_guard lock(_sleepMutex);
+	}
+	_jobAdded.notify_one();
+}
+
+void JobSystem::Wait(JobCounter &counter)
+{
+	ZoneScoped;
+	const auto queue = currentWorker.system == this ?
+				   currentWorker.queue :
+				   (uint32_t)_queues.size() - 1;
+	while (true) {
+		const auto pending = counter._pending.load(std::memory_order_acquire);
+		if (pending == 0) {
+			// The last job may still be notifying, the counter must outlive it
+			while (counter._notifying.load(std::memory_order_acquire) != 0) {
+				std::this_thread::yield();
+			}
+			return;
+		}
+		// Nothing queued, the jobs left are running on other threads
+		if (!TryRun(queue)) {
+			counter._pending.wait(pending, std::memory_order_acquire);
+		}
+	}
+}
+
+uint32_t JobSystem::ThreadCount() const
+{
+	return _workers.size() + 1;
+}
+
+JobSystem &JobSystem::Default()
+{
+	// Leaked, jobs may still run while static objects are destroyed
+	static auto *jobs = new JobSystem();
+	return *jobs;
+}
+
+bool JobSystem::TryRun(uint32_t queue)
+{
+	static const MetricCounter jobCounter("jobs.run");
+	static const MetricCounter stealCounter("jobs.stolen");
+	std::optional<Job> job;
+	{
+		auto &own = *_queues[queue];
+		std::lock_guard lock(own.mutex);
+		if (!own.jobs.empty()) {
+			job = std::move(own.jobs.back());
+			own.jobs.pop_back();
+		}
+	}
+	// Starting after our own queue, so thieves don't all go for the same one
+	for (uint32_t i = 1; !job && i < _queues.size(); ++i) {
+		auto &victim = *_queues[(queue + i) % _queues.size()];
+		std::lock_guard lock(victim.mutex);
+		if (!victim.jobs.empty()) {
+			job = std::move(victim.jobs.front());
+			victim.jobs.pop_front();
+			stealCounter.Add();
+		}
+	}
+	if (!job) {
+		return false;
+	}
+	_queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+
+	{
+		ZoneScopedN("Job");
+		ZoneName(job->name, std::strlen(job->name));
+		job->function();
+	}
+	jobCounter.Add();
+	// Counted before the job is done, a waiter seeing no pending jobs then waits for the notify too
+	auto &counter = *job->counter;
+	counter._notifying.fetch_add(1, std::memory_order_relaxed);
+	if (counter._pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		counter._pending.notify_all();
+	}
+	// Last access, the waiter may destroy the counter right after
+	counter._notifying.fetch_sub(1, std::memory_order_release);
+	return true;
+}
+
+void JobSystem::WorkerThread(std::stop_token stopToken, uint32_t index)
+{
+#ifdef TRACY_ENABLE
+	tracy::SetThreadName(("Job worker " + std::to_string(index)).c_str());
+#endif
+	currentWorker = WorkerContext{ this, index };
+	while (!stopToken.stop_requested()) {
+		if (TryRun(index)) {
+			continue;
+		}
+		std::unique_lock lock(_sleepMutex);
+		_jobAdded.wait(lock, stopToken, [&] {
+			return _queuedJobs.load(std::memory_order_acquire) > 0;
+		});
+	}
+}
+
+TaskGraph::Task TaskGraph::Add(const char *name, std::function<void()> function,
+			       std::initializer_list<Task> dependencies)
+{
+	const auto task = (Task)_nodes.size();
+	_nodes.emplace_back(Node{ name, std::move(function), {},
+				  (uint32_t)dependencies.size() });
+	for (const auto dependency : dependencies) {
+		_nodes[dependency].dependents.emplace_back(task);
+	}
+	return task;
+}
+
+void TaskGraph::Launch(JobSystem &jobs)
+{
+	_jobs = &jobs;
+	if (_remaining.size() != _nodes.size()) {
+		_remaining = std::vector<std::atomic<uint32_t> >(_nodes.size());
+	}
+	for (size_t i = 0; i < _nodes.size(); ++i) {
+		_remaining[i].store(_nodes[i].dependencyCount,
+				    std::memory_order_relaxed);
+	}
+	for (Task task = 0; task < _nodes.size(); ++task) {
+		if (_nodes[task].dependencyCount == 0) {
+			Submit(task);
+		}
+	}
+}
+
+void TaskGraph::Wait()
+{
+	if (_jobs) {
+		_jobs->Wait(_counter);
+	}
+}
+
+void TaskGraph::Run(JobSystem &jobs)
+{
+	Launch(jobs);
+	Wait();
+}
+
+void TaskGraph::Submit(Task task)
+{
+	_jobs->Submit(
+		_nodes[task].name,
+		[this, task] {
+			_nodes[task].function();
+			// Submitted before this job counts as done, so the graph's counter never drops to zero early
+			for (const auto dependent : _nodes[task].dependents) {
+				if (_remaining[dependent].fetch_sub(
+					    1, std::memory_order_acq_rel) == 1) {
+					Submit(dependent);
+				}
+			}
+		},
+		_counter);
+}
\ No newline at end of file
@@ -0,0 +1,380 @@
+#include <RayTracerLib/Metrics.hpp>
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+// Marks a metric that couldn't be registered, recording into it does nothing
+constexpr uint32_t INVALID_SLOT = UINT32_MAX;
+
+struct MetricInfo {
+	std::string name;
+	std::string unit;
+	MetricType type;
+	// Index in the counters, gauges or timers, depending on the type
+	uint32_t slot;
+};
+
+struct TimerSlots {
+	std::atomic<int64_t> nanoseconds;
+	std::atomic<uint64_t> buckets[TIMER_BUCKETS];
+};
+
+// Written by one thread only, read by snapshots. The atomics are only there so reads don't tear.
+struct ThreadMetrics {
+	std::atomic<int64_t> counters[MAX_METRICS];
+	TimerSlots timers[MAX_TIMERS];
+};
+
+struct MetricsRegistry {
+	// Guards everything but the gauges, recording never takes it
+	std::mutex mutex;
+	std::vector<MetricInfo> metrics;
+	uint32_t counterCount = 0;
+	uint32_t gaugeCount = 0;
+	uint32_t timerCount = 0;
+	std::atomic<int64_t> gauges[MAX_METRICS];
+	// Every thread that recorded something, a thread's slots are handed to the next one when it exits
+	std::vector<std::unique_ptr<ThreadMetrics> > threads;
+	std::vector<ThreadMetrics *> freeThreads;
+	std::chrono::steady_clock::time_point start =
+		std::chrono::steady_clock::now();
+};
+
+// Never destroyed, threads may still record while static objects are being destroyed
+static MetricsRegistry &GetRegistry()
+{
+	static auto *registry = new MetricsRegistry();
+	return *registry;
+}
+
+static uint32_t Register(std::string_view name, std::string_view unit,
+			 MetricType type)
+{
+	auto &registry = GetRegistry();
+	std::lock_guard lock(registry.mutex);
+	// The same metric can be registered from several places, they all share it
+	for (const auto &metric : registry.metrics) {
+		if (metric.name != name) {
+			continue;
+		}
+		if (metric.type != type) {
+			spdlog::error(
+				"Metrics: {} is already registered with another type",
+				name);
+			return INVALID_SLOT;
+		}
+		return metric.slot;
+	}
+
+	uint32_t *count = &registry.counterCount;
+	uint32_t capacity = MAX_METRICS;
+	if (type == MetricType::Gauge) {
+		count = &registry.gaugeCount;
+	} else if (type == MetricType::Timer) {
+		count = &registry.timerCount;
+		capacity = MAX_TIMERS;
+	}
+	if (*count >= capacity) {
+		spdlog::error("Metrics: Unable to register {}, too many metrics",
+			      name);
+		return INVALID_SLOT;
+	}
+	registry.metrics.emplace_back(MetricInfo{
+		std::string(name), std::string(unit), type, *count });
+	return (*count)++;
+}
+
+// Hands the thread's slots back when it exits, their totals stay in the snapshots
+class ThreadMetricsHandle {
+    public:
+	~ThreadMetricsHandle()
+	{
+		if (metrics) {
+			auto &registry = GetRegistry();
+			std::lock_guard lock(registry.mutex);
+			registry.freeThreads.emplace_back(metrics);
+		}
+	}
+
+	ThreadMetrics *metrics = nullptr;
+};
+
+static ThreadMetrics &LocalMetrics()
+{
+	thread_local ThreadMetricsHandle handle;
+	if (!handle.metrics) {
+		// Only the first time a thread records something
+		auto &registry = GetRegistry();
+		std::lock_guard lock(registry.mutex);
+		if (registry.freeThreads.empty()) {
+			handle.metrics =
+				registry.threads
+					.emplace_back(std::make_unique<ThreadMetrics>())
+					.get();
+		} else {
+			handle.metrics = registry.freeThreads.back();
+			registry.freeThreads.pop_back();
+		}
+	}
+	return *handle.metrics;
+}
+
+// No other thread writes the value, so there is no need for a locked read-modify-write
+template <typename T> static void Increase(std::atomic<T> &value, T amount)
+{
+	value.store(value.load(std::memory_order_relaxed) + amount,
+		    std::memory_order_relaxed);
+}
+
+static uint32_t BucketOf(double milliseconds)
+{
+	const auto microseconds = milliseconds * 1000.0;
+	// Also catches NaN
+	if (!(microseconds > 1.0)) {
+		return 0;
+	}
+	const auto bucket =
+		(uint32_t)(std::log2(microseconds) * TIMER_BUCKETS_PER_OCTAVE);
+	return std::min(bucket, TIMER_BUCKETS - 1);
+}
+
+// In milliseconds, the first bucket also holds everything below a microsecond
+static double BucketStart(uint32_t bucket)
+{
+	if (bucket == 0) {
+		return 0.0;
+	}
+	return std::exp2((double)bucket / TIMER_BUCKETS_PER_OCTAVE) / 1000.0;
+}
+
+MetricCounter::MetricCounter(std::string_view name, std::string_view unit)
+	: _slot(Register(name, unit, MetricType::Counter))
+{
+}
+
+void MetricCounter::Add(int64_t value) const
+{
+	if (_slot != INVALID_SLOT) {
+		Increase(LocalMetrics().counters[_slot], value);
+	}
+}
+
+MetricGauge::MetricGauge(std::string_view name, std::string_view unit)
+	: _slot(Register(name, unit, MetricType::Gauge))
+{
+}
+
+void MetricGauge::Set(int64_t value) const
+{
+	if (_slot != INVALID_SLOT) {
+		GetRegistry().gauges[_slot].store(value,
+						  std::memory_order_relaxed);
+	}
+}
+
+MetricTimer::MetricTimer(std::string_view name)
+	: _slot(Register(name, "ms", MetricType::Timer))
+{
+}
+
+void MetricTimer::Record(double milliseconds) const
+{
+	if (_slot == INVALID_SLOT) {
+		return;
+	}
+	auto &timer = LocalMetrics().timers[_slot];
+	Increase(timer.nanoseconds, (int64_t)(milliseconds * 1e6));
+	Increase(timer.buckets[BucketOf(milliseconds)], (uint64_t)1);
+}
+
+MetricScope::MetricScope(const MetricTimer &timer)
+	: _timer(timer)
+	, _start(std::chrono::steady_clock::now())
+{
+}
+
+MetricScope::~MetricScope()
+{
+	_timer.Record(std::chrono::duration<double, std::milli>(
+			      std::chrono::steady_clock::now() - _start)
+			      .count());
+}
+
+double MetricValue::MeanMilliseconds() const
+{
+	return count > 0 ? totalMilliseconds / count : 0.0;
+}
+
+double MetricValue::PercentileMilliseconds(double percentile) const
+{
+	if (count == 0) {
+		return 0.0;
+	}
+	// Assumes the samples are spread evenly within their bucket
+	const auto rank = std::clamp(percentile, 0.0, 1.0) * count;
+	uint64_t below = 0;
+	for (uint32_t bucket = 0; bucket < buckets.size(); ++bucket) {
+		if (buckets[bucket] == 0) {
+			continue;
+		}
+		if (below + buckets[bucket] >= rank) {
+			const auto start = BucketStart(bucket);
+			const auto end = BucketStart(bucket + 1);
+			return start + (end - start) * (rank - below) /
+					       buckets[bucket];
+		}
+		below += buckets[bucket];
+	}
+	return BucketStart(buckets.size());
+}
+
+MetricsSnapshot TakeMetricsSnapshot()
+{
+	auto &registry = GetRegistry();
+	MetricsSnapshot snapshot;
+	snapshot.time = std::chrono::steady_clock::now();
+	snapshot.seconds =
+		std::chrono::duration<double>(snapshot.time - registry.start)
+			.count();
+
+	std::lock_guard lock(registry.mutex);
+	for (const auto &metric : registry.metrics) {
+		auto &value = snapshot.values.emplace_back();
+		value.name = metric.name;
+		value.unit = metric.unit;
+		value.type = metric.type;
+		if (metric.type == MetricType::Gauge) {
+			value.value = registry.gauges[metric.slot].load(
+				std::memory_order_relaxed);
+			continue;
+		}
+		if (metric.type == MetricType::Counter) {
+			for (const auto &thread : registry.threads) {
+				value.value += thread->counters[metric.slot].load(
+					std::memory_order_relaxed);
+			}
+			continue;
+		}
+		value.buckets.resize(TIMER_BUCKETS);
+		int64_t nanoseconds = 0;
+		for (const auto &thread : registry.threads) {
+			const auto &timer = thread->timers[metric.slot];
+			nanoseconds += timer.nanoseconds.load(
+				std::memory_order_relaxed);
+			for (uint32_t bucket = 0; bucket < TIMER_BUCKETS;
+			     ++bucket) {
+				value.buckets[bucket] += timer.buckets[bucket].load(
+					std::memory_order_relaxed);
+			}
+		}
+		// Counted from the buckets, so the count always matches the histogram
+		for (const auto samples : value.buckets) {
+			value.count += samples;
+		}
+		value.totalMilliseconds = nanoseconds / 1e6;
+	}
+	std::sort(snapshot.values.begin(), snapshot.values.end(),
+		  [](const MetricValue &a, const MetricValue &b) {
+			  return a.name < b.name;
+		  });
+	return snapshot;
+}
+
+MetricsSnapshot MetricsSnapshot::Since(const MetricsSnapshot &earlier) const
+{
+	auto window = *this;
+	window.seconds =
+		std::chrono::duration<double>(time - earlier.time).count();
+	for (auto &value : window.values) {
+		const auto *previous = earlier.Find(value.name);
+		if (!previous || value.type == MetricType::Gauge) {
+			continue;
+		}
+		value.value -= previous->value;
+		value.count -= previous->count;
+		value.totalMilliseconds -= previous->totalMilliseconds;
+		for (size_t bucket = 0; bucket < value.buckets.size() &&
+					bucket < previous->buckets.size();
+		     ++bucket) {
+			value.buckets[bucket] -= previous->buckets[bucket];
+		}
+	}
+	return window;
+}
+
+const MetricValue *MetricsSnapshot::Find(std::string_view name) const
+{
+	const auto found = std::lower_bound(
+		values.begin(), values.end(), name,
+		[](const MetricValue &value, std::string_view name) {
+			return value.name < name;
+		});
+	if (found == values.end() || found->name != name) {
+		return nullptr;
+	}
+	return &*found;
+}
+
+std::string MetricsSnapshot::ToJson() const
+{
+	// Names and units come from the code, they need no escaping
+	auto json = fmt::format("{{\n\t\"seconds\": {:.3f},\n\t\"metrics\": {{",
+				seconds);
+	bool first = true;
+	for (const auto &value : values) {
+		json += fmt::format("{}\n\t\t\"{}\": ", first ? "" : ",",
+				    value.name);
+		first = false;
+		if (value.type == MetricType::Timer) {
+			json += fmt::format(
+				"{{ \"type\": \"timer\", \"unit\": \"ms\", \"count\": {}, \"mean\": {:.4f}, \"p50\": {:.4f}, \"p90\": {:.4f}, \"p95\": {:.4f}, \"p99\": {:.4f} }}",
+				value.count, value.MeanMilliseconds(),
+				value.PercentileMilliseconds(0.5),
+				value.PercentileMilliseconds(0.9),
+				value.PercentileMilliseconds(0.95),
+				value.PercentileMilliseconds(0.99));
+		} else if (value.type == MetricType::Counter) {
+			json += fmt::format(
+				"{{ \"type\": \"counter\", \"unit\": \"{}\", \"value\": {}, \"rate\": {:.4f} }}",
+				value.unit, value.value,
+				seconds > 0.0 ? value.value / seconds : 0.0);
+		} else {
+			json += fmt::format(
+				"{{ \"type\": \"gauge\", \"unit\": \"{}\", \"value\": {} }}",
+				value.unit, value.value);
+		}
+	}
+	return json + "\n\t}\n}\n";
+}
+
+bool MetricsSnapshot::WriteJson(const std::filesystem::path &path) const
+{
+	std::error_code error;
+	if (path.has_parent_path()) {
+		std::filesystem::create_directories(path.parent_path(), error);
+	}
+	auto temporaryPath = path;
+	temporaryPath += ".tmp";
+	{
+		std::ofstream file(temporaryPath);
+		file << ToJson();
+		if (!file) {
+			spdlog::error("Metrics: Unable to write {}",
+				      temporaryPath.string());
+			return false;
+		}
+	}
+	std::filesystem::rename(temporaryPath, path, error);
+	if (error) {
+		spdlog::error("Metrics: Unable to write {}: {}", path.string(),
+			      error.message());
+		return false;
+	}
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,30 @@
+#include <RayTracerLib/Parallel.hpp>
+
+#include <RayTracerLib/JobSystem.hpp>
+
+#include <algorithm>
+#include <atomic>
+
+void ParallelFor(size_t count, const std::function<void(size_t)> &function)
+{
+	if (count == 0) {
+		return;
+	}
+	// Jobs pull indices from a shared counter, so uneven work still balances out. Jobs that
+	// start once every index is taken return right away.
+	std::atomic<size_t> next = 0;
+	const auto work = [&]() {
+		for (auto index = next++; index < count; index = next++) {
+			function(index);
+		}
+	};
+
+	auto &jobs = JobSystem::Default();
+	const auto jobCount = std::min<size_t>(jobs.ThreadCount(), count);
+	JobCounter counter;
+	for (size_t i = 1; i < jobCount; ++i) {
+		jobs.Submit("ParallelFor", work, counter);
+	}
+	work();
+	jobs.Wait(counter);
+}
\ No newline at end of file
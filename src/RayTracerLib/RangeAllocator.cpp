@@ -0,0 +1,244 @@
+#include <RayTracerLib/RangeAllocator.hpp>
+
+#include <algorithm>
+#include <bit>
+
+// Maps a size to its bin, rounding down: every range in the bin is at least as big as the bin's minimum
+static uint32_t BinIndex(uint32_t size, uint32_t secondLevelBits)
+{
+	const uint32_t secondLevelCount = 1u << secondLevelBits;
+	if (size < secondLevelCount) {
+		// Small sizes get one bin each
+		return size;
+	}
+	const uint32_t highestBit = std::bit_width(size) - 1;
+	const uint32_t firstLevel = highestBit - secondLevelBits + 1;
+	const uint32_t secondLevel =
+		(size >> (highestBit - secondLevelBits)) - secondLevelCount;
+	return firstLevel * secondLevelCount + secondLevel;
+}
+
+float RangeAllocatorStats::Fragmentation() const
+{
+	const auto freeSize = capacity - usedSize;
+	if (freeSize == 0) {
+		return 0.0f;
+	}
+	return 1.0f - (float)largestFreeRange / freeSize;
+}
+
+RangeAllocator::RangeAllocator(uint32_t capacity)
+{
+	std::fill(std::begin(_binHeads), std::end(_binHeads), NONE);
+	Grow(capacity);
+}
+
+RangeAllocator::~RangeAllocator() = default;
+
+std::optional<RangeAllocation> RangeAllocator::Allocate(uint32_t size)
+{
+	if (size == 0) {
+		return RangeAllocation{ 0, 0, NONE };
+	}
+	const auto bin = FindFreeBin(size);
+	if (bin == NONE) {
+		return std::nullopt;
+	}
+
+	const auto index = _binHeads[bin];
+	RemoveFree(index);
+	// Split off what we don't need and give it back to the free lists
+	if (_nodes[index].size > size) {
+		const auto remainder = NewNode(_nodes[index].offset + size,
+					       _nodes[index].size - size);
+		auto &node = _nodes[index];
+		node.size = size;
+		_nodes[remainder].neighborPrevious = index;
+		_nodes[remainder].neighborNext = node.neighborNext;
+		if (node.neighborNext != NONE) {
+			_nodes[node.neighborNext].neighborPrevious = remainder;
+		}
+		node.neighborNext = remainder;
+		if (_lastNode == index) {
+			_lastNode = remainder;
+		}
+		InsertFree(remainder);
+	}
+
+	auto &node = _nodes[index];
+	node.used = true;
+	_usedSize += node.size;
+	_allocationCount++;
+	return RangeAllocation{ node.offset, node.size, index };
+}
+
+void RangeAllocator::Free(const RangeAllocation &allocation)
+{
+	if (allocation.node == NONE) {
+		return;
+	}
+	auto index = allocation.node;
+	_nodes[index].used = false;
+	_usedSize -= _nodes[index].size;
+	_allocationCount--;
+
+	// Merges `next` into `node`, `next` must directly follow `node`
+	const auto merge = [this](uint32_t node, uint32_t next) {
+		_nodes[node].size += _nodes[next].size;
+		_nodes[node].neighborNext = _nodes[next].neighborNext;
+		if (_nodes[next].neighborNext != NONE) {
+			_nodes[_nodes[next].neighborNext].neighborPrevious =
+				node;
+		}
+		if (_lastNode == next) {
+			_lastNode = node;
+		}
+		_nodes[next] = Node();
+		_unusedNodes.emplace_back(next);
+	};
+
+	const auto previous = _nodes[index].neighborPrevious;
+	if (previous != NONE && !_nodes[previous].used) {
+		RemoveFree(previous);
+		merge(previous, index);
+		index = previous;
+	}
+	const auto next = _nodes[index].neighborNext;
+	if (next != NONE && !_nodes[next].used) {
+		RemoveFree(next);
+		merge(index, next);
+	}
+	InsertFree(index);
+}
+
+void RangeAllocator::Grow(uint32_t capacity)
+{
+	if (capacity <= _capacity) {
+		return;
+	}
+	const auto extra = capacity - _capacity;
+	if (_lastNode != NONE && !_nodes[_lastNode].used) {
+		// The end of the range is free already, just make it bigger
+		RemoveFree(_lastNode);
+		_nodes[_lastNode].size += extra;
+		InsertFree(_lastNode);
+	} else {
+		const auto node = NewNode(_capacity, extra);
+		_nodes[node].neighborPrevious = _lastNode;
+		if (_lastNode != NONE) {
+			_nodes[_lastNode].neighborNext = node;
+		}
+		_lastNode = node;
+		InsertFree(node);
+	}
+	_capacity = capacity;
+}
+
+RangeAllocatorStats RangeAllocator::Stats() const
+{
+	RangeAllocatorStats stats;
+	stats.capacity = _capacity;
+	stats.usedSize = _usedSize;
+	stats.allocationCount = _allocationCount;
+	for (const auto head : _binHeads) {
+		for (auto node = head; node != NONE;
+		     node = _nodes[node].binNext) {
+			stats.freeRangeCount++;
+			stats.largestFreeRange = std::max(
+				stats.largestFreeRange, _nodes[node].size);
+		}
+	}
+	return stats;
+}
+
+uint32_t RangeAllocator::NewNode(uint32_t offset, uint32_t size)
+{
+	uint32_t index;
+	if (!_unusedNodes.empty()) {
+		index = _unusedNodes.back();
+		_unusedNodes.pop_back();
+	} else {
+		index = _nodes.size();
+		_nodes.emplace_back();
+	}
+	_nodes[index] = Node();
+	_nodes[index].offset = offset;
+	_nodes[index].size = size;
+	return index;
+}
+
+void RangeAllocator::InsertFree(uint32_t index)
+{
+	const auto bin = BinIndex(_nodes[index].size, SECOND_LEVEL_BITS);
+	auto &node = _nodes[index];
+	node.binPrevious = NONE;
+	node.binNext = _binHeads[bin];
+	if (node.binNext != NONE) {
+		_nodes[node.binNext].binPrevious = index;
+	}
+	_binHeads[bin] = index;
+	_firstLevelMask |= 1u << (bin / SECOND_LEVEL_COUNT);
+	_secondLevelMasks[bin / SECOND_LEVEL_COUNT] |=
+		1u << (bin % SECOND_LEVEL_COUNT);
+}
+
+void RangeAllocator::RemoveFree(uint32_t index)
+{
+	auto &node = _nodes[index];
+	if (node.binPrevious != NONE) {
+		_nodes[node.binPrevious].binNext = node.binNext;
+	} else {
+		// This was the head of the bin
+		const auto bin = BinIndex(node.size, SECOND_LEVEL_BITS);
+		_binHeads[bin] = node.binNext;
+		if (node.binNext == NONE) {
+			const auto firstLevel = bin / SECOND_LEVEL_COUNT;
+			_secondLevelMasks[firstLevel] &=
+				~(1u << (bin % SECOND_LEVEL_COUNT));
+			if (_secondLevelMasks[firstLevel] == 0) {
+				_firstLevelMask &= ~(1u << firstLevel);
+			}
+		}
+	}
+	if (node.binNext != NONE) {
+		_nodes[node.binNext].binPrevious = node.binPrevious;
+	}
+	node.binPrevious = NONE;
+	node.binNext = NONE;
+}
+
+uint32_t RangeAllocator::FindFreeBin(uint32_t size) const
+{
+	// Round the size up to the next bin boundary, so any range in the found bin is big enough
+	uint64_t rounded = size;
+	if (size >= SECOND_LEVEL_COUNT) {
+		const uint32_t highestBit = std::bit_width(size) - 1;
+		rounded += (1ull << (highestBit - SECOND_LEVEL_BITS)) - 1;
+	}
+	if (rounded > UINT32_MAX) {
+		return NONE;
+	}
+	const auto bin = BinIndex((uint32_t)rounded, SECOND_LEVEL_BITS);
+	auto firstLevel = bin / SECOND_LEVEL_COUNT;
+	const auto secondLevel = bin % SECOND_LEVEL_COUNT;
+
+	// Look for a non empty bin in the same first level
+	const uint32_t secondLevelMask = _secondLevelMasks[firstLevel] &
+					 (~0u << secondLevel);
+	if (secondLevelMask != 0) {
+		return firstLevel * SECOND_LEVEL_COUNT +
+		       std::countr_zero(secondLevelMask);
+	}
+	// Otherwise take the smallest bin of a bigger first level
+	if (firstLevel + 1 >= FIRST_LEVEL_COUNT) {
+		return NONE;
+	}
+	const uint32_t firstLevelMask = _firstLevelMask &
+					(~0u << (firstLevel + 1));
+	if (firstLevelMask == 0) {
+		return NONE;
+	}
+	firstLevel = std::countr_zero(firstLevelMask);
+	return firstLevel * SECOND_LEVEL_COUNT +
+	       std::countr_zero((uint32_t)_secondLevelMasks[firstLevel]);
+}
@@ -0,0 +1,172 @@
+#include <RayTracerLib/TextureCache.hpp>
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <fstream>
+
+// "RTEX" in little endian
+static constexpr uint32_t MAGIC = 0x58455452;
+
+struct FileHeader {
+	uint32_t magic;
+	uint32_t version;
+	TextureFormat format;
+	uint32_t levelCount;
+};
+
+struct FileLevel {
+	uint32_t width;
+	uint32_t height;
+	// In bytes, from the start of the file
+	uint64_t offset;
+	uint64_t size;
+};
+
+TextureCache::TextureCache(std::filesystem::path directory)
+	: _directory(std::move(directory))
+{
+}
+
+std::filesystem::path TextureCache::PathFor(uint64_t key) const
+{
+	return _directory / fmt::format("{:016x}.tex", key);
+}
+
+// Reads the header and the level table, returns false if the file isn't a valid cache file
+static bool ReadLevelTable(std::ifstream &file, FileHeader &header,
+			   std::vector<FileLevel> &levels)
+{
+	file.read((char *)&header, sizeof(header));
+	if (!file || header.magic != MAGIC ||
+	    header.version != TextureCache::VERSION || header.levelCount == 0) {
+		return false;
+	}
+	levels.resize(header.levelCount);
+	file.read((char *)levels.data(), levels.size() * sizeof(FileLevel));
+	return (bool)file;
+}
+
+// Appends levels [firstLevel, firstLevel + count) to `texture`
+static bool ReadLevels(std::ifstream &file, const FileHeader &header,
+		       const std::vector<FileLevel> &levels, uint32_t firstLevel,
+		       uint32_t count, TextureData &texture)
+{
+	for (uint32_t i = firstLevel; i < firstLevel + count; ++i) {
+		const auto &level = levels[i];
+		// A truncated or stale file must not produce a texture GL would read past
+		if (level.size !=
+		    TextureLevelSize(header.format, level.width, level.height)) {
+			return false;
+		}
+		auto &destination = texture.levels.emplace_back(TextureLevel{
+			level.width, level.height,
+			std::vector<uint8_t>(level.size) });
+		// Only the levels we need are read, streaming reads a few levels at a time
+		file.seekg(level.offset);
+		file.read((char *)destination.data.data(), level.size);
+		if (!file) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool TextureCache::Load(uint64_t key, TextureData &texture) const
+{
+	return LoadLevels(PathFor(key), 0, UINT32_MAX, texture);
+}
+
+bool TextureCache::LoadCoarse(uint64_t key, uint32_t maxSize,
+			      TextureData &texture) const
+{
+	std::ifstream file(PathFor(key), std::ios::binary);
+	FileHeader header = {};
+	std::vector<FileLevel> levels;
+	if (!file || !ReadLevelTable(file, header, levels)) {
+		return false;
+	}
+	uint32_t firstLevel = 0;
+	while (firstLevel + 1 < levels.size() &&
+	       std::max(levels[firstLevel].width, levels[firstLevel].height) >
+		       maxSize) {
+		++firstLevel;
+	}
+
+	texture.format = header.format;
+	texture.levels.clear();
+	// The finer levels only get their size, their data is read when they are streamed in
+	for (uint32_t i = 0; i < firstLevel; ++i) {
+		texture.levels.emplace_back(
+			TextureLevel{ levels[i].width, levels[i].height, {} });
+	}
+	return ReadLevels(file, header, levels, firstLevel,
+			  header.levelCount - firstLevel, texture);
+}
+
+bool TextureCache::LoadLevels(const std::filesystem::path &path,
+			      uint32_t firstLevel, uint32_t count,
+			      TextureData &texture)
+{
+	std::ifstream file(path, std::ios::binary);
+	FileHeader header = {};
+	std::vector<FileLevel> levels;
+	if (!file || !ReadLevelTable(file, header, levels) ||
+	    firstLevel >= header.levelCount) {
+		return false;
+	}
+
+	texture.format = header.format;
+	texture.levels.clear();
+	count = std::min(count, header.levelCount - firstLevel);
+	return ReadLevels(file, header, levels, firstLevel, count, texture);
+}
+
+bool TextureCache::Store(uint64_t key, const TextureData &texture) const
+{
+	std::error_code error;
+	std::filesystem::create_directories(_directory, error);
+	if (error) {
+		spdlog::error("TextureCache: Unable to create {}: {}",
+			      _directory.string(), error.message());
+		return false;
+	}
+
+	const FileHeader header = { MAGIC, VERSION, texture.format,
+				    (uint32_t)texture.levels.size() };
+	std::vector<FileLevel> levels;
+	uint64_t offset =
+		sizeof(FileHeader) + texture.levels.size() * sizeof(FileLevel);
+	for (const auto &level : texture.levels) {
+		levels.emplace_back(FileLevel{ level.width, level.height, offset,
+					       level.data.size() });
+		offset += level.data.size();
+	}
+
+	// Write to a temporary file first, so a crash never leaves a partial file behind the final name
+	const auto path = PathFor(key);
+	auto temporaryPath = path;
+	temporaryPath += ".tmp";
+	{
+		std::ofstream file(temporaryPath, std::ios::binary);
+		file.write((const char *)&header, sizeof(header));
+		file.write((const char *)levels.data(),
+			   levels.size() * sizeof(FileLevel));
+		for (const auto &level : texture.levels) {
+			file.write((const char *)level.data.data(),
+				   level.data.size());
+		}
+		if (!file) {
+			spdlog::error("TextureCache: Unable to write {}",
+				      temporaryPath.string());
+			return false;
+		}
+	}
+	std::filesystem::rename(temporaryPath, path, error);
+	if (error) {
+		spdlog::error("TextureCache: Unable to write {}: {}",
+			      path.string(), error.message());
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,496 @@
+#include <RayTracerLib/TextureCompression.hpp>
+
+#include <RayTracerLib/Parallel.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+
+// BC7 4-bit index interpolation weights, out of 64
+static constexpr uint32_t BC7_WEIGHTS[16] = { 0,  4,  9,  13, 17, 21, 26, 30,
+					      34, 38, 43, 47, 51, 55, 60, 64 };
+
+uint32_t MipLevelCount(uint32_t width, uint32_t height)
+{
+	return std::bit_width(std::max(std::max(width, height), 1u));
+}
+
+size_t TextureLevelSize(TextureFormat format, uint32_t width, uint32_t height)
+{
+	const size_t blocks = (size_t)((width + 3) / 4) * ((height + 3) / 4);
+	switch (format) {
+	case TextureFormat::BC1:
+		return blocks * 8;
+	case TextureFormat::BC5:
+	case TextureFormat::BC7:
+		return blocks * 16;
+	default:
+		return (size_t)width * height * 4;
+	}
+}
+
+TextureData BuildMipChain(const uint8_t *rgba, uint32_t width, uint32_t height)
+{
+	TextureData result;
+	result.format = TextureFormat::RGBA8;
+	const auto levelCount = MipLevelCount(width, height);
+	result.levels.reserve(levelCount);
+	result.levels.emplace_back(TextureLevel{
+		width, height,
+		std::vector<uint8_t>(rgba, rgba + (size_t)width * height * 4) });
+	for (uint32_t level = 1; level < levelCount; ++level) {
+		const auto &source = result.levels.back();
+		TextureLevel next;
+		next.width = std::max(source.width / 2, 1u);
+		next.height = std::max(source.height / 2, 1u);
+		next.data.resize((size_t)next.width * next.height * 4);
+		for (uint32_t y = 0; y < next.height; ++y) {
+			// Odd sizes repeat the last row/column
+			const auto y0 = std::min(y * 2, source.height - 1);
+			const auto y1 = std::min(y * 2 + 1, source.height - 1);
+			for (uint32_t x = 0; x < next.width; ++x) {
+				const auto x0 = std::min(x * 2, source.width - 1);
+				const auto x1 =
+					std::min(x * 2 + 1, source.width - 1);
+				for (uint32_t c = 0; c < 4; ++c) {
+					const auto sum =
+						source.data[(y0 * source.width + x0) * 4 + c] +
+						source.data[(y0 * source.width + x1) * 4 + c] +
+						source.data[(y1 * source.width + x0) * 4 + c] +
+						source.data[(y1 * source.width + x1) * 4 + c];
+					next.data[(y * next.width + x) * 4 + c] =
+						(sum + 2) / 4;
+				}
+			}
+		}
+		result.levels.emplace_back(std::move(next));
+	}
+	return result;
+}
+
+// Finds the axis along which the texels vary the most (first `channels` channels),
+// with a few rounds of power iteration on the covariance matrix
+static void PrincipalAxis(const uint8_t *texels, uint32_t channels,
+			  float *mean, float *axis)
+{
+	for (uint32_t c = 0; c < channels; ++c) {
+		mean[c] = 0.0f;
+		for (uint32_t i = 0; i < 16; ++i) {
+			mean[c] += texels[i * 4 + c];
+		}
+		mean[c] /= 16.0f;
+	}
+	float covariance[4][4] = {};
+	for (uint32_t i = 0; i < 16; ++i) {
+		for (uint32_t a = 0; a < channels; ++a) {
+			for (uint32_t b = 0; b < channels; ++b) {
+				covariance[a][b] +=
+					(texels[i * 4 + a] - mean[a]) *
+					(texels[i * 4 + b] - mean[b]);
+			}
+		}
+	}
+	// Start from the two texels farthest apart, a fixed seed like (1, 1, 1) is orthogonal to the
+	// axis of blocks that only change hue (red and green) and would never leave zero
+	uint32_t first = 0;
+	uint32_t second = 0;
+	float farthest = 0.0f;
+	for (uint32_t i = 0; i < 16; ++i) {
+		for (uint32_t j = i + 1; j < 16; ++j) {
+			float distance = 0.0f;
+			for (uint32_t c = 0; c < channels; ++c) {
+				const float d = (float)texels[i * 4 + c] -
+						texels[j * 4 + c];
+				distance += d * d;
+			}
+			if (distance > farthest) {
+				farthest = distance;
+				first = i;
+				second = j;
+			}
+		}
+	}
+	for (uint32_t c = 0; c < channels; ++c) {
+		axis[c] = (float)texels[first * 4 + c] - texels[second * 4 + c];
+	}
+	for (uint32_t iteration = 0; iteration < 8; ++iteration) {
+		float next[4] = {};
+		float length = 0.0f;
+		for (uint32_t a = 0; a < channels; ++a) {
+			for (uint32_t b = 0; b < channels; ++b) {
+				next[a] += covariance[a][b] * axis[b];
+			}
+			length = std::max(length, std::abs(next[a]));
+		}
+		if (length == 0.0f) {
+			// Every texel is the same, any axis works
+			break;
+		}
+		for (uint32_t c = 0; c < channels; ++c) {
+			axis[c] = next[c] / length;
+		}
+	}
+}
+
+// Projects the texels on the principal axis and returns the two extreme points
+static void FitEndpoints(const uint8_t *texels, uint32_t channels, float *low,
+			 float *high)
+{
+	float mean[4];
+	float axis[4];
+	PrincipalAxis(texels, channels, mean, axis);
+	float minimum = 0.0f;
+	float maximum = 0.0f;
+	for (uint32_t i = 0; i < 16; ++i) {
+		float t = 0.0f;
+		for (uint32_t c = 0; c < channels; ++c) {
+			t += (texels[i * 4 + c] - mean[c]) * axis[c];
+		}
+		minimum = std::min(minimum, t);
+		maximum = std::max(maximum, t);
+	}
+	float lengthSquared = 0.0f;
+	for (uint32_t c = 0; c < channels; ++c) {
+		lengthSquared += axis[c] * axis[c];
+	}
+	if (lengthSquared == 0.0f) {
+		// No axis, the bounding box of the texels still keeps every channel's range
+		for (uint32_t c = 0; c < channels; ++c) {
+			low[c] = 255.0f;
+			high[c] = 0.0f;
+			for (uint32_t i = 0; i < 16; ++i) {
+				low[c] = std::min(low[c], (float)texels[i * 4 + c]);
+				high[c] = std::max(high[c], (float)texels[i * 4 + c]);
+			}
+		}
+		return;
+	}
+	minimum /= lengthSquared;
+	maximum /= lengthSquared;
+	for (uint32_t c = 0; c < channels; ++c) {
+		low[c] = std::clamp(mean[c] + axis[c] * minimum, 0.0f, 255.0f);
+		high[c] = std::clamp(mean[c] + axis[c] * maximum, 0.0f, 255.0f);
+	}
+}
+
+static uint16_t PackRgb565(const float *color)
+{
+	const auto r = (uint32_t)std::lround(color[0] * 31.0f / 255.0f);
+	const auto g = (uint32_t)std::lround(color[1] * 63.0f / 255.0f);
+	const auto b = (uint32_t)std::lround(color[2] * 31.0f / 255.0f);
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void UnpackRgb565(uint16_t packed, int32_t *color)
+{
+	const auto r = (packed >> 11) & 31;
+	const auto g = (packed >> 5) & 63;
+	const auto b = packed & 31;
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+}
+
+void EncodeBlockBC1(const uint8_t *texels, uint8_t *block)
+{
+	float low[4];
+	float high[4];
+	FitEndpoints(texels, 3, low, high);
+	auto color0 = PackRgb565(high);
+	auto color1 = PackRgb565(low);
+	// color0 > color1 selects the 4 color mode, equal endpoints only need index 0
+	if (color0 < color1) {
+		std::swap(color0, color1);
+	}
+	uint32_t indices = 0;
+	if (color0 != color1) {
+		int32_t palette[4][3];
+		UnpackRgb565(color0, palette[0]);
+		UnpackRgb565(color1, palette[1]);
+		for (uint32_t c = 0; c < 3; ++c) {
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		for (uint32_t i = 0; i < 16; ++i) {
+			uint32_t best = 0;
+			int32_t bestError = INT32_MAX;
+			for (uint32_t p = 0; p < 4; ++p) {
+				int32_t error = 0;
+				for (uint32_t c = 0; c < 3; ++c) {
+					const auto d = texels[i * 4 + c] -
+						       palette[p][c];
+					error += d * d;
+				}
+				if (error < bestError) {
+					bestError = error;
+					best = p;
+				}
+			}
+			indices |= best << (i * 2);
+		}
+	}
+	block[0] = color0 & 0xff;
+	block[1] = color0 >> 8;
+	block[2] = color1 & 0xff;
+	block[3] = color1 >> 8;
+	std::memcpy(block + 4, &indices, sizeof(indices));
+}
+
+// Encodes one channel of the block as BC4 (8 bytes)
+static void EncodeBlockBC4(const uint8_t *texels, uint32_t channel,
+			   uint8_t *block)
+{
+	uint8_t minimum = 255;
+	uint8_t maximum = 0;
+	for (uint32_t i = 0; i < 16; ++i) {
+		minimum = std::min(minimum, texels[i * 4 + channel]);
+		maximum = std::max(maximum, texels[i * 4 + channel]);
+	}
+	// red0 > red1 selects the 8 value mode
+	block[0] = maximum;
+	block[1] = minimum;
+	uint64_t indices = 0;
+	if (maximum != minimum) {
+		int32_t palette[8];
+		palette[0] = maximum;
+		palette[1] = minimum;
+		for (uint32_t p = 2; p < 8; ++p) {
+			palette[p] = ((8 - p) * maximum + (p - 1) * minimum) / 7;
+		}
+		for (uint32_t i = 0; i < 16; ++i) {
+			uint64_t best = 0;
+			int32_t bestError = INT32_MAX;
+			for (uint32_t p = 0; p < 8; ++p) {
+				const auto error = std::abs(
+					texels[i * 4 + channel] - palette[p]);
+				if (error < bestError) {
+					bestError = error;
+					best = p;
+				}
+			}
+			indices |= best << (i * 3);
+		}
+	}
+	for (uint32_t i = 0; i < 6; ++i) {
+		block[2 + i] = (indices >> (i * 8)) & 0xff;
+	}
+}
+
+void EncodeBlockBC5(const uint8_t *texels, uint8_t *block)
+{
+	EncodeBlockBC4(texels, 0, block);
+	EncodeBlockBC4(texels, 1, block + 8);
+}
+
+// BC7 mode 6 endpoint: 7 bits per channel plus a p-bit shared by the 4 channels
+struct Bc7Endpoint {
+	uint32_t color[4];
+	uint32_t pbit;
+};
+
+static Bc7Endpoint QuantizeBc7Endpoint(const float *color)
+{
+	Bc7Endpoint best = {};
+	float bestError = INFINITY;
+	for (uint32_t pbit = 0; pbit < 2; ++pbit) {
+		Bc7Endpoint candidate = {};
+		candidate.pbit = pbit;
+		float error = 0.0f;
+		for (uint32_t c = 0; c < 4; ++c) {
+			const auto value = std::clamp(
+				(int32_t)std::lround((color[c] - pbit) / 2.0f),
+				0, 127);
+			candidate.color[c] = value;
+			const auto d = color[c] - (float)((value << 1) | pbit);
+			error += d * d;
+		}
+		if (error < bestError) {
+			bestError = error;
+			best = candidate;
+		}
+	}
+	return best;
+}
+
+// Picks the nearest palette entry for every texel, returns the total squared error
+static uint32_t FindBc7Indices(const uint8_t *texels, const Bc7Endpoint &e0,
+			       const Bc7Endpoint &e1, uint8_t *indices)
+{
+	int32_t palette[16][4];
+	for (uint32_t c = 0; c < 4; ++c) {
+		const int32_t a = (e0.color[c] << 1) | e0.pbit;
+		const int32_t b = (e1.color[c] << 1) | e1.pbit;
+		for (uint32_t p = 0; p < 16; ++p) {
+			palette[p][c] = ((64 - BC7_WEIGHTS[p]) * a +
+					 BC7_WEIGHTS[p] * b + 32) >>
+					6;
+		}
+	}
+	uint32_t totalError = 0;
+	for (uint32_t i = 0; i < 16; ++i) {
+		uint32_t bestError = UINT32_MAX;
+		for (uint32_t p = 0; p < 16; ++p) {
+			uint32_t error = 0;
+			for (uint32_t c = 0; c < 4; ++c) {
+				const auto d = texels[i * 4 + c] - palette[p][c];
+				error += d * d;
+			}
+			if (error < bestError) {
+				bestError = error;
+				indices[i] = p;
+			}
+		}
+		totalError += bestError;
+	}
+	return totalError;
+}
+
+// Writes `count` bits of `value` at `offset` in a little endian 128-bit block
+static void WriteBits(uint8_t *block, uint32_t &offset, uint32_t value,
+		      uint32_t count)
+{
+	for (uint32_t i = 0; i < count; ++i, ++offset) {
+		if ((value >> i) & 1) {
+			block[offset / 8] |= 1 << (offset % 8);
+		}
+	}
+}
+
+void EncodeBlockBC7(const uint8_t *texels, uint8_t *block)
+{
+	// Mode 6 only: one subset, RGBA endpoints and 4-bit indices,
+	// the best single mode for smooth content and alpha
+	float low[4];
+	float high[4];
+	FitEndpoints(texels, 4, low, high);
+	auto e0 = QuantizeBc7Endpoint(low);
+	auto e1 = QuantizeBc7Endpoint(high);
+	uint8_t indices[16];
+	auto error = FindBc7Indices(texels, e0, e1, indices);
+
+	// Refine the endpoints with a least squares fit for the chosen indices
+	float aa = 0.0f;
+	float ab = 0.0f;
+	float bb = 0.0f;
+	float ax[4] = {};
+	float bx[4] = {};
+	for (uint32_t i = 0; i < 16; ++i) {
+		const auto t = BC7_WEIGHTS[indices[i]] / 64.0f;
+		aa += (1.0f - t) * (1.0f - t);
+		ab += (1.0f - t) * t;
+		bb += t * t;
+		for (uint32_t c = 0; c < 4; ++c) {
+			ax[c] += (1.0f - t) * texels[i * 4 + c];
+			bx[c] += t * texels[i * 4 + c];
+		}
+	}
+	const auto determinant = aa * bb - ab * ab;
+	if (std::abs(determinant) > 1e-6f) {
+		float refinedLow[4];
+		float refinedHigh[4];
+		for (uint32_t c = 0; c < 4; ++c) {
+			refinedLow[c] = std::clamp(
+				(ax[c] * bb - bx[c] * ab) / determinant, 0.0f,
+				255.0f);
+			refinedHigh[c] = std::clamp(
+				(bx[c] * aa - ax[c] * ab) / determinant, 0.0f,
+				255.0f);
+		}
+		const auto r0 = QuantizeBc7Endpoint(refinedLow);
+		const auto r1 = QuantizeBc7Endpoint(refinedHigh);
+		uint8_t refinedIndices[16];
+		const auto refinedError =
+			FindBc7Indices(texels, r0, r1, refinedIndices);
+		if (refinedError < error) {
+			e0 = r0;
+			e1 = r1;
+			error = refinedError;
+			std::memcpy(indices, refinedIndices, sizeof(indices));
+		}
+	}
+
+	// The first index is stored with 3 bits, its top bit must be 0: swap the endpoints if it isn't
+	if (indices[0] & 8) {
+		std::swap(e0, e1);
+		for (auto &index : indices) {
+			index = 15 - index;
+		}
+	}
+
+	std::memset(block, 0, 16);
+	uint32_t offset = 0;
+	// Mode 6 is encoded as 6 zero bits followed by a one
+	WriteBits(block, offset, 1 << 6, 7);
+	for (uint32_t c = 0; c < 4; ++c) {
+		WriteBits(block, offset, e0.color[c], 7);
+		WriteBits(block, offset, e1.color[c], 7);
+	}
+	WriteBits(block, offset, e0.pbit, 1);
+	WriteBits(block, offset, e1.pbit, 1);
+	WriteBits(block, offset, indices[0], 3);
+	for (uint32_t i = 1; i < 16; ++i) {
+		WriteBits(block, offset, indices[i], 4);
+	}
+}
+
+TextureData CompressTexture(const TextureData &rgba, TextureFormat format)
+{
+	TextureData result;
+	result.format = format;
+	if (format == TextureFormat::RGBA8) {
+		result.levels = rgba.levels;
+		return result;
+	}
+
+	const auto blockBytes = TextureLevelSize(format, 4, 4);
+	const auto encode = format == TextureFormat::BC1 ? EncodeBlockBC1 :
+			    format == TextureFormat::BC5 ? EncodeBlockBC5 :
+							   EncodeBlockBC7;
+	// Every row of blocks of every level is a work item, so small levels don't serialize the work
+	struct BlockRow {
+		uint32_t level;
+		uint32_t row;
+	};
+	std::vector<BlockRow> rows;
+	for (uint32_t level = 0; level < rgba.levels.size(); ++level) {
+		const auto &source = rgba.levels[level];
+		result.levels.emplace_back(TextureLevel{
+			source.width, source.height,
+			std::vector<uint8_t>(TextureLevelSize(
+				format, source.width, source.height)) });
+		for (uint32_t row = 0; row < (source.height + 3) / 4; ++row) {
+			rows.emplace_back(BlockRow{ level, row });
+		}
+	}
+
+	ParallelFor(rows.size(), [&](size_t i) {
+		const auto &source = rgba.levels[rows[i].level];
+		auto &destination = result.levels[rows[i].level];
+		const auto blocksPerRow = (source.width + 3) / 4;
+		uint8_t texels[64];
+		for (uint32_t bx = 0; bx < blocksPerRow; ++bx) {
+			// Gather the 4x4 texels, blocks that go past the edge repeat the last texels
+			for (uint32_t y = 0; y < 4; ++y) {
+				const auto sy = std::min(rows[i].row * 4 + y,
+							 source.height - 1);
+				for (uint32_t x = 0; x < 4; ++x) {
+					const auto sx = std::min(bx * 4 + x,
+								 source.width - 1);
+					std::memcpy(&texels[(y * 4 + x) * 4],
+						    &source.data[((size_t)sy *
+									  source.width +
+								  sx) *
+								 4],
+						    4);
+				}
+			}
+			encode(texels,
+			       &destination.data[((size_t)rows[i].row *
+							  blocksPerRow +
+						  bx) *
+						 blockBytes]);
+		}
+	});
+	return result;
+}
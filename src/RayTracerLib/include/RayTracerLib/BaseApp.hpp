@@ -1,18 +1,75 @@
 #pragma once
+#include <RayTracerLib/Benchmark.hpp>
+#include <RayTracerLib/FrameCapture.hpp>
+#include <RayTracerLib/GpuTimer.hpp>
+#include <RayTracerLib/JobSystem.hpp>
+#include <RayTracerLib/Metrics.hpp>
+
+#include <bitset>
+#include <chrono>
 #include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
 
 struct GLFWwindow;
 
+struct BaseAppOptions
+{
+    // Renders into an offscreen framebuffer, without a visible window or UI.
+    // Uses a surfaceless EGL context when available, a hidden window otherwise.
+    bool headless = false;
+    bool vsync = true;
+    int32_t width = 1920;
+    int32_t height = 1080;
+    // Stops after this many frames, 0 runs until the window is closed
+    uint64_t frameCount = 0;
+    // Seconds between frames, 0 uses the wall clock.
+    // With a fixed step everything driven by GetTime depends on the frame index only.
+    double fixedDeltaTime = 0.0;
+    // Frame timings are written to <benchmarkOutput>.csv and .json when set
+    std::string benchmarkOutput;
+    // The metrics recorded over the last `metricsInterval` seconds are written there when set
+    std::string metricsOutput;
+    double metricsInterval = 10.0;
+    // The scene of every frame, without the UI, is written there as an image sequence when set
+    std::string captureDirectory;
+    CaptureFormat captureFormat = CaptureFormat::PNG;
+    // Waits for the image writers instead of dropping frames when they fall behind
+    bool captureEveryFrame = false;
+    // Frames the CPU may run ahead of the GPU. With 2 or more the next frame is prepared while
+    // this one is submitted. 1 prepares, submits and waits for each frame in turn, for the
+    // lowest latency.
+    uint32_t maxFramesInFlight = 2;
+};
+
+// The frame the frame graph is preparing
+struct FrameInfo
+{
+    uint64_t index = 0;
+    // When the frame should be shown, GetTime once it's rendered (an estimate without a fixed step)
+    double time = 0.0;
+    float deltaTime = 0.0f;
+};
+
 class BaseApp
 {
 public:
+    BaseApp(const BaseAppOptions& options = {});
+
     void Run();
 
 protected:
     void Close();
     bool IsKeyPressed(int32_t key);
-    
+
     double GetDeltaTime();
+    // Seconds since the first frame, frame index times the fixed step when there is one
+    double GetTime() const;
+    uint64_t GetFrameIndex() const;
+    int32_t GetWidth() const;
+    int32_t GetHeight() const;
+    bool IsHeadless() const;
 
     virtual void AfterCreatedUiContext();
     virtual void BeforeDestroyUiContext();
@@ -21,11 +78,71 @@ protected:
     virtual void Unload();
     virtual void RenderScene(float deltaTime);
     virtual void RenderUI(float deltaTime);
+    // Runs on the main thread, before the frame is prepared and with no other frame work running
     virtual void Update(float deltaTime);
-
+    // Adds the CPU work of a frame (simulation, draw lists) to `graph`, called once after Load.
+    // The graph runs on the job system while RenderScene submits the previous frame, so its tasks
+    // must not use OpenGL, ImGui or GLFW, nor change anything RenderScene reads. They get their
+    // frame from PreparingFrame, GetTime and GetFrameIndex are the frame being rendered.
+    virtual void BuildFrameGraph(TaskGraph& graph);
+    const FrameInfo& PreparingFrame() const;
+    // Call after changing something the prepared frame uses (loading or unloading models),
+    // from the main thread. The frame is prepared again before it's rendered.
+    void DiscardPreparedFrame();
 
 private:
     GLFWwindow* _windowHandle = nullptr;
     void Render(float deltaTime);
+    bool InitializeWindow();
+    bool InitializeEgl();
+    bool ShouldClose() const;
+    // Window size and keys, read once per frame on the main thread so the frame graph can use them
+    void TakeInputSnapshot();
+    // Blocks until the GPU is less than `maxFramesInFlight` frames behind
+    void WaitForFramesInFlight();
+    // Adds the GPU timings read back since the last call to the report
+    void RecordGpuTimes();
+    // Refreshes the overlay's values and writes the metrics when they are due
+    void UpdateMetrics();
+    void RenderMetrics();
+
+    // Above GLFW_KEY_LAST
+    static constexpr int32_t KEY_COUNT = 512;
+
+    struct InputSnapshot
+    {
+        int32_t width = 0;
+        int32_t height = 0;
+        std::bitset<KEY_COUNT> keys;
+    };
+
+    BaseAppOptions _options;
+    InputSnapshot _input;
+    bool _closeRequested = false;
+    bool _uiEnabled = false;
+    uint64_t _frameIndex = 0;
+    double _time = 0.0;
+    std::chrono::steady_clock::time_point _startTime;
+    // Headless rendering happens in this framebuffer
+    uint32_t _framebuffer = 0;
+    uint32_t _colorBuffer = 0;
+    uint32_t _depthBuffer = 0;
+    // EGL objects, opaque so EGL stays out of this header
+    void* _eglDisplay = nullptr;
+    void* _eglContext = nullptr;
+    // Only records frames when benchmarking, released with the context
+    std::unique_ptr<GpuTimer> _gpuTimer;
+    std::unique_ptr<FrameCapture> _capture;
+    BenchmarkReport _report;
+    // The overlay shows the window between the last two snapshots
+    MetricsSnapshot _overlaySnapshot;
+    MetricsSnapshot _overlayWindow;
+    MetricsSnapshot _outputSnapshot;
+    TaskGraph _frameGraph;
+    FrameInfo _preparingFrame;
+    // True when the graph was launched for the next frame
+    bool _framePrepared = false;
+    // One fence per frame the GPU may still be working on, oldest first
+    std::deque<void*> _frameFences;
 
 };
\ No newline at end of file
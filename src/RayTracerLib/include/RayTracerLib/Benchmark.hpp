@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Value below which `percentile` (in [0, 1]) of the values fall, interpolated between the two
+// closest values. Returns 0 without values.
+double Percentile(std::vector<double> values, double percentile);
+
+// Collects per-frame timings, in milliseconds, into named series ("cpu", "gpu.Scene", ...).
+// `Write` produces <path>.csv with one row per frame and <path>.json with the run's info and
+// the mean, min, max and percentiles of every series.
+class BenchmarkReport {
+    public:
+	// Describes the run in the JSON summary, e.g. the renderer or the frame count
+	void SetInfo(std::string key, std::string_view value);
+	void SetInfo(std::string key, double value);
+	void Add(uint64_t frame, std::string_view series, double milliseconds);
+	bool Write(const std::filesystem::path &path) const;
+
+    private:
+	// Values are already formatted as JSON
+	std::vector<std::pair<std::string, std::string>> _info;
+	std::vector<std::string> _names;
+	// One vector per series indexed by frame, NaN where a frame has no value
+	std::vector<std::vector<double>> _values;
+};
\ No newline at end of file
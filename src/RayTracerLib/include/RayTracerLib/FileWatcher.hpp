@@ -0,0 +1,40 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Canonical form of a path that may not exist, paths reported by the watcher are in this form
+std::filesystem::path CanonicalPath(const std::filesystem::path &path);
+
+struct FileChange {
+	// Canonical path of the file that was written
+	std::filesystem::path path;
+	// When the change was picked up, to measure how long reacting to it takes
+	std::chrono::steady_clock::time_point time;
+};
+
+// Reports files written under the watched directories (and their subdirectories).
+// Built on inotify, on other platforms nothing is ever reported.
+class FileWatcher {
+    public:
+	FileWatcher();
+	~FileWatcher();
+
+	FileWatcher(const FileWatcher &) = delete;
+	FileWatcher &operator=(const FileWatcher &) = delete;
+
+	// Watching the same directory twice is fine
+	bool Watch(const std::filesystem::path &directory);
+	// Returns the files written since the last call, each file once, never blocks
+	std::vector<FileChange> Poll();
+
+    private:
+	bool WatchOne(const std::filesystem::path &directory);
+
+	int _fd = -1;
+	// inotify watch descriptors and the directory they watch
+	std::unordered_map<int, std::filesystem::path> _directories;
+};
\ No newline at end of file
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+enum class CaptureFormat : uint32_t {
+	PNG,
+	// Uncompressed half float, the 8-bit sRGB framebuffer converted to linear
+	EXR,
+};
+
+struct FrameCaptureOptions {
+	// Frames are written there as frame_000000.png, numbered by the frame index
+	std::filesystem::path directory;
+	CaptureFormat format = CaptureFormat::PNG;
+	// Threads encoding and writing images, 0 uses a couple, the cores are left to the job system
+	uint32_t workerCount = 0;
+	// Frames read back or encoding at once, each holds a whole frame in memory
+	uint32_t maxQueuedFrames = 16;
+	// Waits for the workers when they fall behind instead of dropping frames, for sequences that
+	// must be complete, rendered with a fixed time step
+	bool blockWhenFull = false;
+};
+
+struct FrameCaptureStats {
+	uint64_t captured = 0;
+	uint64_t written = 0;
+	// Not captured because the queue was full
+	uint64_t dropped = 0;
+	// Captured but couldn't be written
+	uint64_t failed = 0;
+	// Read back or encoding right now
+	uint32_t queued = 0;
+};
+
+// Writes rendered frames to image files without stalling the renderer. Frames are read into a
+// ring of pixel buffers, a fence tells when the copy is done, and only then the pixels are handed
+// to worker threads that encode and write them. Reading never waits for the frame just rendered.
+class FrameCapture {
+    public:
+	// Pixel buffers in the ring, the GPU can be this many captures behind before Capture waits
+	static constexpr uint32_t RING_SIZE = 3;
+
+	FrameCapture(const FrameCaptureOptions &options);
+	// Writes every frame still in flight, needs the context
+	~FrameCapture();
+
+	FrameCapture(const FrameCapture &) = delete;
+	FrameCapture &operator=(const FrameCapture &) = delete;
+
+	// Reads the color of the framebuffer bound for reading, from (0, 0)
+	void Capture(uint64_t frame, int32_t width, int32_t height);
+	// Hands the frames whose copy is done to the workers, called by Capture too
+	void Poll();
+	// Waits until every frame is written
+	void Flush();
+	FrameCaptureStats Stats();
+
+    private:
+	struct Slot {
+		uint32_t buffer = 0;
+		size_t size = 0;
+		// Persistently mapped, the fence tells when it can be read
+		const uint8_t *pixels = nullptr;
+		void *fence = nullptr;
+		uint64_t frame = 0;
+		int32_t width = 0;
+		int32_t height = 0;
+	};
+
+	struct Job {
+		uint64_t frame;
+		int32_t width;
+		int32_t height;
+		// RGBA8, bottom row first like OpenGL returns it
+		std::vector<uint8_t> pixels;
+	};
+
+	// Returns false when the copy isn't done and `wait` is false
+	bool Collect(Slot &slot, bool wait);
+	// Makes room for one more frame, returns false when it has to be dropped
+	bool Reserve();
+	void WorkerThread(std::stop_token stopToken);
+	bool Write(const Job &job) const;
+
+	FrameCaptureOptions _options;
+	Slot _slots[RING_SIZE];
+	uint32_t _nextSlot = 0;
+	// Shared with the workers
+	std::mutex _mutex;
+	std::condition_variable_any _jobAdded;
+	std::condition_variable _jobDone;
+	std::deque<Job> _jobs;
+	// Frames captured and not yet written, wherever they are
+	uint32_t _outstanding = 0;
+	FrameCaptureStats _stats;
+	// Declared last, they must stop before the queue they use is destroyed
+	std::vector<std::jthread> _workers;
+};
\ No newline at end of file
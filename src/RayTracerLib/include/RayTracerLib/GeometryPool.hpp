@@ -0,0 +1,79 @@
+#pragma once
+
+#include <RayTracerLib/RangeAllocator.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// Describes one attribute of the pool's vertex format, mirrors glVertexArrayAttribFormat
+struct GeometryPoolAttribute {
+	uint32_t location;
+	int32_t components;
+	// GL_FLOAT, GL_SHORT, ...
+	uint32_t type;
+	bool normalized;
+	uint32_t offset;
+};
+
+struct GeometryPoolCreateInfo {
+	std::vector<GeometryPoolAttribute> attributes;
+	uint32_t vertexStride;
+	// Either 2 or 4 bytes
+	uint32_t indexSize;
+	// Initial capacities in vertices and indices, the pool grows when they run out
+	uint32_t vertexCapacity;
+	uint32_t indexCapacity;
+};
+
+struct GeometryPoolStats {
+	RangeAllocatorStats vertices;
+	RangeAllocatorStats indices;
+	uint32_t vertexStride;
+	uint32_t indexSize;
+	// Number of times the GPU buffers had to be reallocated
+	uint32_t growCount;
+};
+
+// Large vertex and index buffers shared by every model, each model allocates ranges in them.
+// Because everything lives in the same buffers, all resident geometry can be drawn with a
+// single VAO and a single indirect buffer.
+class GeometryPool {
+    public:
+	GeometryPool(const GeometryPoolCreateInfo &info);
+	~GeometryPool();
+
+	GeometryPool(const GeometryPool &) = delete;
+	GeometryPool &operator=(const GeometryPool &) = delete;
+
+	// Offsets and sizes are in vertices and indices, not bytes
+	RangeAllocation AllocateVertices(uint32_t count);
+	RangeAllocation AllocateIndices(uint32_t count);
+	void FreeVertices(const RangeAllocation &allocation);
+	void FreeIndices(const RangeAllocation &allocation);
+	// `offset` is relative to the start of the allocation, in vertices or indices
+	void UploadVertices(const RangeAllocation &allocation, uint32_t offset,
+			    const void *data, size_t bytes);
+	void UploadIndices(const RangeAllocation &allocation, uint32_t offset,
+			   const void *data, size_t bytes);
+
+	void Bind() const;
+	uint32_t VertexStride() const;
+	uint32_t IndexSize() const;
+	// GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	uint32_t IndexType() const;
+	GeometryPoolStats Stats() const;
+
+    private:
+	// Reallocates `buffer` with a bigger size, keeping its contents
+	void GrowBuffer(uint32_t &buffer, size_t oldBytes, size_t newBytes);
+
+	GeometryPoolCreateInfo _info;
+	RangeAllocator _vertexAllocator;
+	RangeAllocator _indexAllocator;
+	uint32_t _vao = 0;
+	uint32_t _vbo = 0;
+	uint32_t _ibo = 0;
+	uint32_t _growCount = 0;
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct GpuTimerResult {
+	uint64_t frame;
+	std::string pass;
+	double milliseconds;
+};
+
+// Measures how long the GPU spends on named passes with GL_TIME_ELAPSED queries.
+// Results arrive a few frames late: the queries of a frame are only read back when its slot
+// of the ring comes around again, by then the GPU is done with them and reading doesn't stall.
+// Time elapsed queries can't be nested, a pass must end before the next one begins.
+class GpuTimer {
+    public:
+	// Frames recorded before their queries are read back
+	static constexpr uint32_t FRAMES_IN_FLIGHT = 4;
+
+	GpuTimer() = default;
+	~GpuTimer();
+
+	GpuTimer(const GpuTimer &) = delete;
+	GpuTimer &operator=(const GpuTimer &) = delete;
+
+	// Reads back the oldest frame of the ring, then records into its slot
+	void BeginFrame(uint64_t frame);
+	void Begin(std::string_view pass);
+	void End();
+	// Waits for every frame still in flight, used once rendering is over
+	void Flush();
+	// Results read back since the last call, in frame order
+	std::vector<GpuTimerResult> TakeResults();
+
+    private:
+	struct Query {
+		uint32_t handle;
+		uint32_t pass;
+	};
+
+	struct Frame {
+		uint64_t frame = 0;
+		// Queries are kept when the frame is read back and reused by the next one
+		std::vector<uint32_t> handles;
+		std::vector<Query> queries;
+	};
+
+	void ReadBack(Frame &frame);
+
+	Frame _frames[FRAMES_IN_FLIGHT];
+	Frame *_current = nullptr;
+	std::vector<std::string> _passes;
+	std::vector<GpuTimerResult> _results;
+};
\ No newline at end of file
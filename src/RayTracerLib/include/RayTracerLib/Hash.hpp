@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Fast non-cryptographic 64-bit hash, used to key caches on content
+uint64_t HashBytes(const void *data, size_t size, uint64_t seed = 0);
+uint64_t HashString(std::string_view string, uint64_t seed = 0);
+// Combines two hashes, order matters
+uint64_t HashCombine(uint64_t hash, uint64_t value);
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Number of jobs of a group that aren't done yet, JobSystem::Wait waits for it to reach zero.
+// Once it is done no worker touches it anymore, so it can live on the waiter's stack.
+class JobCounter {
+    public:
+	bool IsDone() const;
+
+    private:
+	friend class JobSystem;
+	std::atomic<uint32_t> _pending = 0;
+	// Workers between counting their job done and waking the waiters
+	std::atomic<uint32_t> _notifying = 0;
+};
+
+struct JobSystemOptions {
+	// Threads running jobs, 0 uses every core but the one submitting
+	uint32_t workerCount = 0;
+};
+
+// Runs jobs on a pool of worker threads. Every worker has its own queue: it runs the jobs it
+// submits from the back, the newest whose data is still in its cache, and when it runs out it
+// steals the oldest jobs of the others. Threads waiting for jobs run queued jobs meanwhile, so jobs
+// can submit jobs and wait for them.
+class JobSystem {
+    public:
+	JobSystem(const JobSystemOptions &options = {});
+	// Runs the jobs still queued first
+	~JobSystem();
+
+	JobSystem(const JobSystem &) = delete;
+	JobSystem &operator=(const JobSystem &) = delete;
+
+	// `name` names the job's zone in the profiler, it must outlive the job (a literal)
+	void Submit(const char *name, std::function<void()> job,
+		    JobCounter &counter);
+	// Returns once every job counted by `counter` is done, running jobs while there are some
+	void Wait(JobCounter &counter);
+	// Workers, plus the thread that waits
+	uint32_t ThreadCount() const;
+
+	// Used by ParallelFor and the frame loop, created on first use and never destroyed
+	static JobSystem &Default();
+
+    private:
+	struct Job {
+		const char *name;
+		std::function<void()> function;
+		JobCounter *counter;
+	};
+
+	struct Queue {
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	// Takes a job from `queue`'s back, or the front of another queue, returns false when all are empty
+	bool TryRun(uint32_t queue);
+	void WorkerThread(std::stop_token stopToken, uint32_t index);
+
+	// One per worker, and a last one shared by the threads that aren't workers
+	std::vector<std::unique_ptr<Queue> > _queues;
+	// Workers sleep when every queue is empty
+	std::mutex _sleepMutex;
+	std::condition_variable_any _jobAdded;
+	// Signed, a job can be taken before the submitter counted it
+	std::atomic<int32_t> _queuedJobs = 0;
+	// Declared last, they must stop before the queues they use are destroyed
+	std::vector<std::jthread> _workers;
+};
+
+// Jobs and the order they must run in, a task is submitted once every task it depends on is
+// done. The graph is built once and can be run again, every frame for instance.
+class TaskGraph {
+    public:
+	using Task = uint32_t;
+
+	// Dependencies must be added before the task, so the graph can't have cycles
+	Task Add(const char *name, std::function<void()> function,
+		 std::initializer_list<Task> dependencies = {});
+	// Submits the tasks without dependencies, the others follow as their dependencies finish
+	void Launch(JobSystem &jobs);
+	// Waits for every task of the last launch
+	void Wait();
+	void Run(JobSystem &jobs);
+
+    private:
+	struct Node {
+		const char *name;
+		std::function<void()> function;
+		std::vector<Task> dependents;
+		uint32_t dependencyCount;
+	};
+
+	void Submit(Task task);
+
+	std::vector<Node> _nodes;
+	// Dependencies of each task not done yet in the current launch
+	std::vector<std::atomic<uint32_t> > _remaining;
+	JobSystem *_jobs = nullptr;
+	JobCounter _counter;
+};
\ No newline at end of file
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Process wide counters, gauges and timers, cheap enough to record every frame with or without
+// a profiler attached. Every thread adds to its own slots, recording never takes a lock, and a
+// snapshot sums the slots of all threads. Metrics are registered once, usually as function
+// statics, and live until the process exits.
+//
+//	static const MetricCounter drawCalls("scene.draw_calls");
+//	drawCalls.Add(count);
+
+enum class MetricType : uint8_t {
+	// Summed over every thread since the start, a snapshot window shows how much was added
+	Counter,
+	// Last value set by any thread, e.g. the memory in use
+	Gauge,
+	// Durations in milliseconds, with a histogram for percentiles
+	Timer,
+};
+
+// At most this many metrics, and this many of them timers, registering more logs an error and
+// returns a metric that records nothing
+constexpr uint32_t MAX_METRICS = 256;
+constexpr uint32_t MAX_TIMERS = 64;
+// Timer histograms have 4 buckets per power of two from 1 microsecond, up to about 16 seconds,
+// so percentiles are off by less than a bucket's 19%
+constexpr uint32_t TIMER_BUCKETS_PER_OCTAVE = 4;
+constexpr uint32_t TIMER_BUCKETS = 24 * TIMER_BUCKETS_PER_OCTAVE;
+
+class MetricCounter {
+    public:
+	MetricCounter(std::string_view name, std::string_view unit = "");
+	void Add(int64_t value = 1) const;
+
+    private:
+	uint32_t _slot;
+};
+
+class MetricGauge {
+    public:
+	MetricGauge(std::string_view name, std::string_view unit = "");
+	void Set(int64_t value) const;
+
+    private:
+	uint32_t _slot;
+};
+
+class MetricTimer {
+    public:
+	MetricTimer(std::string_view name);
+	void Record(double milliseconds) const;
+
+    private:
+	uint32_t _slot;
+};
+
+// Records the time until it goes out of scope
+class MetricScope {
+    public:
+	MetricScope(const MetricTimer &timer);
+	~MetricScope();
+
+	MetricScope(const MetricScope &) = delete;
+	MetricScope &operator=(const MetricScope &) = delete;
+
+    private:
+	const MetricTimer &_timer;
+	std::chrono::steady_clock::time_point _start;
+};
+
+struct MetricValue {
+	std::string name;
+	std::string unit;
+	MetricType type = MetricType::Counter;
+	// Counter total or gauge value
+	int64_t value = 0;
+	// Timers only
+	uint64_t count = 0;
+	double totalMilliseconds = 0.0;
+	std::vector<uint64_t> buckets;
+
+	double MeanMilliseconds() const;
+	// Estimated from the histogram, `percentile` is in [0, 1]. Returns 0 without samples.
+	double PercentileMilliseconds(double percentile) const;
+};
+
+struct MetricsSnapshot {
+	std::chrono::steady_clock::time_point time;
+	// Seconds covered by the snapshot, since the start or since the earlier snapshot of `Since`
+	double seconds = 0.0;
+	// Sorted by name
+	std::vector<MetricValue> values;
+
+	// What was recorded between `earlier` and this snapshot, gauges keep their current value
+	MetricsSnapshot Since(const MetricsSnapshot &earlier) const;
+	const MetricValue *Find(std::string_view name) const;
+	std::string ToJson() const;
+	// Replaces the file at once, so a reader never sees a partial file
+	bool WriteJson(const std::filesystem::path &path) const;
+};
+
+MetricsSnapshot TakeMetricsSnapshot();
\ No newline at end of file
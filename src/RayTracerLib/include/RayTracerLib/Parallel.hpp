@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+// Calls `function(index)` for every index in [0, count), spread over the default job system.
+// The calling thread takes part in the work and returns once every index has been processed,
+// it can be called from a job.
+void ParallelFor(size_t count, const std::function<void(size_t)> &function);
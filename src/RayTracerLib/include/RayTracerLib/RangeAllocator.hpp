@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// A range handed out by `RangeAllocator`, offsets and sizes are in whatever unit the owner uses
+struct RangeAllocation {
+	uint32_t offset = 0;
+	uint32_t size = 0;
+	// Internal node index, needed to free the range
+	uint32_t node = 0;
+};
+
+struct RangeAllocatorStats {
+	uint32_t capacity = 0;
+	uint32_t usedSize = 0;
+	uint32_t allocationCount = 0;
+	uint32_t freeRangeCount = 0;
+	uint32_t largestFreeRange = 0;
+
+	// 0 when all the free space is contiguous, approaching 1 as it gets split into small ranges
+	float Fragmentation() const;
+};
+
+// Two-level segregated fit (TLSF) allocator for ranges of a linear resource, like a GPU buffer.
+// Free ranges are binned by size (a power of two, then 8 linear steps), so allocating and freeing
+// are O(1), neighbouring free ranges are merged when freed.
+class RangeAllocator {
+    public:
+	RangeAllocator(uint32_t capacity);
+	~RangeAllocator();
+
+	std::optional<RangeAllocation> Allocate(uint32_t size);
+	void Free(const RangeAllocation &allocation);
+	// Extends the managed range, existing allocations are untouched
+	void Grow(uint32_t capacity);
+	RangeAllocatorStats Stats() const;
+
+    private:
+	static constexpr uint32_t NONE = UINT32_MAX;
+	static constexpr uint32_t SECOND_LEVEL_BITS = 3;
+	static constexpr uint32_t SECOND_LEVEL_COUNT = 1 << SECOND_LEVEL_BITS;
+	static constexpr uint32_t FIRST_LEVEL_COUNT = 32;
+	static constexpr uint32_t BIN_COUNT =
+		FIRST_LEVEL_COUNT * SECOND_LEVEL_COUNT;
+
+	struct Node {
+		uint32_t offset = 0;
+		uint32_t size = 0;
+		bool used = false;
+		// Free list of the bin this node is in
+		uint32_t binPrevious = NONE;
+		uint32_t binNext = NONE;
+		// Nodes that are adjacent in the managed range
+		uint32_t neighborPrevious = NONE;
+		uint32_t neighborNext = NONE;
+	};
+
+	uint32_t NewNode(uint32_t offset, uint32_t size);
+	void InsertFree(uint32_t node);
+	void RemoveFree(uint32_t node);
+	uint32_t FindFreeBin(uint32_t size) const;
+
+	std::vector<Node> _nodes;
+	// Indices of nodes in `_nodes` that can be reused
+	std::vector<uint32_t> _unusedNodes;
+	uint32_t _binHeads[BIN_COUNT];
+	// Bit i is set when first level i has a non empty bin
+	uint32_t _firstLevelMask = 0;
+	// Bit j of entry i is set when bin (i, j) is non empty
+	uint8_t _secondLevelMasks[FIRST_LEVEL_COUNT] = {};
+	// The node that ends at `_capacity`
+	uint32_t _lastNode = NONE;
+	uint32_t _capacity = 0;
+	uint32_t _usedSize = 0;
+	uint32_t _allocationCount = 0;
+};
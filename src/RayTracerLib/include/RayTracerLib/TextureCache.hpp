@@ -0,0 +1,33 @@
+#pragma once
+
+#include <RayTracerLib/TextureCompression.hpp>
+
+#include <cstdint>
+#include <filesystem>
+
+// Stores encoded textures on disk, one file per key, so warm loads skip decoding and compression.
+// A file holds a small header, a table with the size and offset of every level, then the levels.
+class TextureCache {
+    public:
+	// Bump when the file layout or the encoders change, older files are ignored
+	static constexpr uint32_t VERSION = 1;
+
+	TextureCache(std::filesystem::path directory);
+
+	// Returns false if there is no valid file for `key`
+	bool Load(uint64_t key, TextureData &texture) const;
+	// Loads the levels no larger than `maxSize` (at least the last one), the finer levels are
+	// there with their size but no data
+	bool LoadCoarse(uint64_t key, uint32_t maxSize,
+			TextureData &texture) const;
+	bool Store(uint64_t key, const TextureData &texture) const;
+	std::filesystem::path PathFor(uint64_t key) const;
+
+	// Reads at most `count` levels of a cache file, starting at `firstLevel`
+	static bool LoadLevels(const std::filesystem::path &path,
+			       uint32_t firstLevel, uint32_t count,
+			       TextureData &texture);
+
+    private:
+	std::filesystem::path _directory;
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// The value of each enumerator is stored in texture cache files
+enum class TextureFormat : uint32_t {
+	// Uncompressed, 4 bytes per texel
+	RGBA8 = 0,
+	// RGB, 8 bytes per 4x4 block, alpha is dropped
+	BC1 = 1,
+	// Two independent channels (RG), 16 bytes per 4x4 block, meant for normal maps
+	BC5 = 2,
+	// RGBA, 16 bytes per 4x4 block
+	BC7 = 3,
+};
+
+struct TextureLevel {
+	uint32_t width;
+	uint32_t height;
+	std::vector<uint8_t> data;
+};
+
+struct TextureData {
+	TextureFormat format;
+	// Level 0 is the full resolution image
+	std::vector<TextureLevel> levels;
+};
+
+// Number of levels of a full mip chain, down to 1x1
+uint32_t MipLevelCount(uint32_t width, uint32_t height);
+// Size of a level in `format`, compressed formats are stored in whole 4x4 blocks
+size_t TextureLevelSize(TextureFormat format, uint32_t width, uint32_t height);
+// Builds a full mip chain from an RGBA8 image, with a 2x2 box filter
+TextureData BuildMipChain(const uint8_t *rgba, uint32_t width, uint32_t height);
+
+// Each block encoder reads 4x4 RGBA8 texels (64 bytes, row major)
+void EncodeBlockBC1(const uint8_t *texels, uint8_t *block);
+void EncodeBlockBC5(const uint8_t *texels, uint8_t *block);
+void EncodeBlockBC7(const uint8_t *texels, uint8_t *block);
+
+// Compresses every level of an RGBA8 texture, blocks are spread over all hardware threads
+TextureData CompressTexture(const TextureData &rgba, TextureFormat format);